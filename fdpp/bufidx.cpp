@@ -0,0 +1,77 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* purpose: index of the DOS block buffers by (unit, blkno).
+ * The index is a hint: the caller must check that the buffer it
+ * points to still holds the requested block. It is ordered, so
+ * that a range of blocks can be invalidated without walking the
+ * whole LRU list. */
+
+#include <map>
+#include "bufidx.h"
+
+static std::map<uint64_t, uint16_t> bmap;
+
+static uint64_t mk_key(int unit, uint32_t blkno)
+{
+    return ((uint64_t)(uint8_t)unit << 32) | blkno;
+}
+
+void bufidx_reset(void)
+{
+    bmap.clear();
+}
+
+void bufidx_add(int unit, uint32_t blkno, uint16_t off)
+{
+    bmap[mk_key(unit, blkno)] = off;
+}
+
+void bufidx_del(int unit, uint32_t blkno, uint16_t off)
+{
+    auto it = bmap.find(mk_key(unit, blkno));
+
+    if (it != bmap.end() && it->second == off)
+        bmap.erase(it);
+}
+
+void bufidx_del_unit(int unit)
+{
+    bmap.erase(bmap.lower_bound(mk_key(unit, 0)),
+            bmap.upper_bound(mk_key(unit, UINT32_MAX)));
+}
+
+int bufidx_find(int unit, uint32_t blkno)
+{
+    auto it = bmap.find(mk_key(unit, blkno));
+
+    if (it == bmap.end())
+        return -1;
+    return it->second;
+}
+
+/* find the first indexed block in [*blkno, high] */
+int bufidx_next(int unit, uint32_t *blkno, uint32_t high)
+{
+    auto it = bmap.lower_bound(mk_key(unit, *blkno));
+
+    if (it == bmap.end() || it->first > mk_key(unit, high))
+        return -1;
+    *blkno = it->first & UINT32_MAX;
+    return it->second;
+}
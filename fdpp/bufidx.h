@@ -0,0 +1,37 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUFIDX_H
+#define BUFIDX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void bufidx_reset(void);
+void bufidx_add(int unit, uint32_t blkno, uint16_t off);
+void bufidx_del(int unit, uint32_t blkno, uint16_t off);
+void bufidx_del_unit(int unit);
+int bufidx_find(int unit, uint32_t blkno);
+int bufidx_next(int unit, uint32_t *blkno, uint32_t high);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
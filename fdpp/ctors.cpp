@@ -23,6 +23,8 @@
 #include "thunks_priv.h"
 #include "ctors.hpp"
 
+ctor_tmp *ctor_tmp::head;
+
 static std::unordered_set<ctor_base*>& ctor_list()
 {
     /* https://isocpp.org/wiki/faq/ctors#static-init-order-on-first-use */
@@ -47,4 +49,6 @@ void run_ctors()
     std::for_each(ctor_list().begin(), ctor_list().end(), [] (ctor_base *c) {
         c->init();
     });
+    for (const ctor_tmp *t = ctor_tmp::head; t; t = t->get_next())
+        fdloudprintf("%s: error: leaked object\n", t->name());
 }
@@ -74,11 +74,34 @@ public:
     virtual void init() { std::memcpy(ptr, holder, sizeof(T) * L); }
 };
 
-class ctor_log : public ctor_base {
-    const std::string &msg;
+/* Temporaries that must not survive a reboot. They are kept on an
+ * intrusive list rather than in the ctor set, so creating one costs
+ * no allocation. run_ctors() reports the ones still alive. */
+class ctor_tmp {
+    const char *nm;
+    ctor_tmp *prev = nullptr;
+    ctor_tmp *next;
 public:
-    ctor_log(const std::string &m) : msg(m) {}
-    virtual void init() { fdloudprintf("%s\n", msg.c_str()); }
+    static ctor_tmp *head;
+
+    ctor_tmp(const char *n) : nm(n), next(head) {
+        if (head)
+            head->prev = this;
+        head = this;
+    }
+    ~ctor_tmp() {
+        if (prev)
+            prev->next = next;
+        else
+            head = next;
+        if (next)
+            next->prev = prev;
+    }
+    const char *name() const { return nm; }
+    const ctor_tmp *get_next() const { return next; }
+
+    ctor_tmp(const ctor_tmp &) = delete;
+    ctor_tmp& operator =(const ctor_tmp &) = delete;
 };
 
 #define CTOR(t, n, i) t n; static ctor<t> _ctor_##n(&n, i)
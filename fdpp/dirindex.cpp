@@ -0,0 +1,182 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* purpose: find a name in a directory without reading all of its
+ * entries. An index maps the 11-byte FCB names of one directory,
+ * keyed by (unit, start cluster), to their entry numbers. It is
+ * built by one full scan on the first lookup; fatdir.c then reports
+ * every entry it writes. Lookups are only hints: the kernel reads
+ * the entry back and compares the name, so a stale entry can cost a
+ * read but never a wrong match. What must hold is that a complete
+ * index knows every name present, as "not found" is trusted.
+ * Indexes are evicted least recently used first. */
+
+#include <cstring>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "dirindex.h"
+
+#define NAME_LEN 11
+#define MAX_DIRS 64
+
+struct dir_ix {
+    uint64_t key;
+    bool done;
+    std::unordered_map<std::string, std::vector<uint16_t> > byname;
+    std::unordered_map<uint16_t, std::string> byent;
+};
+
+typedef std::list<dir_ix> ix_list;
+
+static ix_list ilist;           // front is most recently used
+static std::map<uint64_t, ix_list::iterator> imap;
+
+static uint64_t mk_key(int unit, uint32_t dir)
+{
+    return ((uint64_t)(uint8_t)unit << 32) | dir;
+}
+
+static dir_ix *get_ix(int unit, uint32_t dir)
+{
+    auto m = imap.find(mk_key(unit, dir));
+
+    if (m == imap.end())
+        return nullptr;
+    return &*m->second;
+}
+
+static void drop_ix(ix_list::iterator it)
+{
+    imap.erase(it->key);
+    ilist.erase(it);
+}
+
+static void rm_entry(dir_ix *ix, unsigned entry)
+{
+    auto e = ix->byent.find(entry);
+
+    if (e == ix->byent.end())
+        return;
+    auto n = ix->byname.find(e->second);
+    std::vector<uint16_t> &v = n->second;
+    for (auto it = v.begin(); it != v.end(); ++it) {
+        if (*it == entry) {
+            v.erase(it);
+            break;
+        }
+    }
+    if (v.empty())
+        ix->byname.erase(n);
+    ix->byent.erase(e);
+}
+
+/* 1: *entry is the first entry >= from named name
+ * 0: the directory has no such entry
+ * -1: no complete index for the directory */
+int dirindex_find(int unit, uint32_t dir, const char *name, unsigned from,
+        unsigned *entry)
+{
+    auto m = imap.find(mk_key(unit, dir));
+
+    if (m == imap.end() || !m->second->done)
+        return -1;
+    ilist.splice(ilist.begin(), ilist, m->second);
+    dir_ix &ix = *m->second;
+    auto n = ix.byname.find(std::string(name, NAME_LEN));
+    if (n == ix.byname.end())
+        return 0;
+    for (uint16_t e : n->second) {
+        if (e >= from) {
+            *entry = e;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void dirindex_begin(int unit, uint32_t dir)
+{
+    uint64_t key = mk_key(unit, dir);
+    auto m = imap.find(key);
+
+    if (m != imap.end())
+        drop_ix(m->second);
+    if (ilist.size() >= MAX_DIRS)
+        drop_ix(std::prev(ilist.end()));
+    ilist.push_front(dir_ix());
+    ilist.front().key = key;
+    ilist.front().done = false;
+    imap[key] = ilist.begin();
+}
+
+/* name is NULL for a deleted or unused entry */
+void dirindex_set(int unit, uint32_t dir, unsigned entry, const char *name)
+{
+    dir_ix *ix = get_ix(unit, dir);
+
+    if (!ix)
+        return;
+    rm_entry(ix, entry);
+    if (!name)
+        return;
+    std::string nm(name, NAME_LEN);
+    std::vector<uint16_t> &v = ix->byname[nm];
+    auto it = v.begin();
+    while (it != v.end() && *it < entry)
+        ++it;
+    v.insert(it, entry);
+    ix->byent[entry] = nm;
+}
+
+void dirindex_done(int unit, uint32_t dir)
+{
+    dir_ix *ix = get_ix(unit, dir);
+
+    if (ix)
+        ix->done = true;
+}
+
+void dirindex_del(int unit, uint32_t dir)
+{
+    auto m = imap.find(mk_key(unit, dir));
+
+    if (m != imap.end())
+        drop_ix(m->second);
+}
+
+void dirindex_del_unit(int unit)
+{
+    ix_list::iterator it = ilist.begin();
+
+    while (it != ilist.end()) {
+        ix_list::iterator next = std::next(it);
+        if ((it->key >> 32) == (uint8_t)unit)
+            drop_ix(it);
+        it = next;
+    }
+}
+
+void dirindex_reset(void)
+{
+    imap.clear();
+    ilist.clear();
+}
@@ -0,0 +1,40 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DIRINDEX_H
+#define DIRINDEX_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int dirindex_find(int unit, uint32_t dir, const char *name, unsigned from,
+        unsigned *entry);
+void dirindex_begin(int unit, uint32_t dir);
+void dirindex_set(int unit, uint32_t dir, unsigned entry, const char *name);
+void dirindex_done(int unit, uint32_t dir);
+void dirindex_del(int unit, uint32_t dir);
+void dirindex_del_unit(int unit);
+void dirindex_reset(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
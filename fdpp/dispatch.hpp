@@ -16,13 +16,15 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <functional>
-
 enum DispStat { DISP_OK, DISP_NORET };
 
+/* The kernel function is called directly: no std::function wrapper,
+ * which type-erases the call and may allocate for the closure.
+ * NORET still unwinds with an exception, as the destructors of the
+ * live FarObj's on the stack must run to copy the objects back and
+ * to keep objtrace consistent. longjmp() would skip them. */
 template<typename T, typename ...A>
-static inline int _dispatch(enum DispStat *rs,
-        std::function<T(A...)> func, A... a)
+static inline int fdpp_dispatch(enum DispStat *rs, T (*func)(A... fa), A... a)
 {
     int ret;
     try {
@@ -36,26 +38,21 @@ static inline int _dispatch(enum DispStat *rs,
     return ret;
 }
 
-template<typename T, typename ...A>
-static inline int fdpp_dispatch(enum DispStat *rs, T (*func)(A... fa), A... a)
-{
-    return _dispatch(rs, std::function<T(A...)>(func), a...);
-}
-
 template<typename ...A>
 static inline int fdpp_dispatch_v(enum DispStat *rs, void (*func)(A... fa), A... a)
 {
-    return _dispatch(
-        rs,
-        std::function<int(A...)>([func] (A... _a) {
-            func(_a...);
-            return 0;
-        }),
-        a...
-    );
+    try {
+        func(a...);
+        *rs = DISP_OK;
+    }
+    catch (int p) {
+        *rs = DISP_NORET;
+        return p;
+    }
+    return 0;
 }
 
-static inline void fdpp_noret(int stat)
+[[noreturn]] static inline void fdpp_noret(int stat)
 {
     throw(stat);
 }
@@ -44,7 +44,8 @@ void dosobj_init(far_t fa, int size)
 
     if (initialized)
         smdestroy(&pool);
-    sminit(&pool, ptr, size);
+    /* objects are small and short-lived: use the granule mode */
+    sminit_gran(&pool, ptr, size, DOSOBJ_GRAN);
     smregister_error_notifier(&pool, err_printf);
     base = fa;
     initialized = 1;
@@ -58,7 +59,7 @@ void dosobj_reinit(far_t fa, int size)
     assert(initialized);
     leaked = smdestroy(&pool);
     assert(!leaked);
-    sminit(&pool, ptr, size);
+    sminit_gran(&pool, ptr, size, DOSOBJ_GRAN);
     base = fa;
 }
 
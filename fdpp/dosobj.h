@@ -21,6 +21,12 @@
 
 #include <stdint.h>
 
+/* The pool hands out whole granules, so each live object wastes at
+ * most DOSOBJ_GRAN - 1 bytes. DOSOBJ_POOL_SIZE() adds room for that
+ * for up to 32 live objects; see smbench.c for measured numbers. */
+#define DOSOBJ_GRAN 2
+#define DOSOBJ_POOL_SIZE(n) ((n) + 32 * (DOSOBJ_GRAN - 1))
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -0,0 +1,232 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* purpose: keep the images of recently executed programs, so that
+ * running the same tool again does not read it through the FAT
+ * layer. An entry holds the load image as it is in the file and
+ * the relocation table, and is keyed by (unit, start cluster); the
+ * size and time stamp of the file must also match.
+ * fatfs.c drops the entry whenever the file is written, renamed or
+ * deleted. Entries are evicted least recently used first. */
+
+#include <cstring>
+#include <list>
+#include <map>
+#include <vector>
+#include "execache.h"
+
+struct exe_ent {
+    int id;
+    uint64_t key;
+    uint32_t size;
+    uint16_t date;
+    uint16_t time;
+    bool done;
+    std::vector<uint8_t> image;
+    std::vector<uint32_t> relocs;
+};
+
+typedef std::list<exe_ent> exe_list;
+
+static exe_list elist;          // front is most recently used
+static std::map<uint64_t, exe_list::iterator> emap;
+static std::map<int, exe_list::iterator> eids;
+static size_t max_bytes;
+static size_t cur_bytes;
+static int next_id;
+/* loads do not nest: at most one entry is being filled */
+static int pending_id = -1;
+
+static uint64_t mk_key(int unit, uint32_t start)
+{
+    return ((uint64_t)(uint8_t)unit << 32) | start;
+}
+
+static size_t ent_bytes(const exe_ent &e)
+{
+    return e.image.size() + e.relocs.size() * sizeof(uint32_t);
+}
+
+static void drop_ent(exe_list::iterator it)
+{
+    if (it->done)
+        cur_bytes -= ent_bytes(*it);
+    if (it->id == pending_id)
+        pending_id = -1;
+    emap.erase(it->key);
+    eids.erase(it->id);
+    elist.erase(it);
+}
+
+static exe_ent *get_ent(int id)
+{
+    auto it = eids.find(id);
+
+    if (it == eids.end())
+        return nullptr;
+    return &*it->second;
+}
+
+void execache_setup(unsigned kbytes)
+{
+    while (!elist.empty())
+        drop_ent(elist.begin());
+    max_bytes = (size_t)kbytes * 1024;
+}
+
+int execache_enabled(void)
+{
+    return !!max_bytes;
+}
+
+int execache_find(int unit, uint32_t start, uint32_t size, uint16_t date,
+        uint16_t time)
+{
+    auto m = emap.find(mk_key(unit, start));
+
+    if (m == emap.end())
+        return -1;
+    exe_list::iterator it = m->second;
+    if (!it->done)
+        return -1;
+    if (it->size != size || it->date != date || it->time != time) {
+        drop_ent(it);
+        return -1;
+    }
+    elist.splice(elist.begin(), elist, it);
+    return it->id;
+}
+
+int execache_new(int unit, uint32_t start, uint32_t size, uint16_t date,
+        uint16_t time)
+{
+    uint64_t key = mk_key(unit, start);
+
+    /* a load that never got to execache_done() was aborted */
+    if (pending_id != -1)
+        execache_drop(pending_id);
+    if (!max_bytes || size > max_bytes)
+        return -1;
+    auto m = emap.find(key);
+    if (m != emap.end())
+        drop_ent(m->second);
+    elist.push_front(exe_ent());
+    exe_ent &e = elist.front();
+    e.id = next_id++;
+    e.key = key;
+    e.size = size;
+    e.date = date;
+    e.time = time;
+    e.done = false;
+    emap[key] = elist.begin();
+    eids[e.id] = elist.begin();
+    pending_id = e.id;
+    return e.id;
+}
+
+void execache_put(int id, const void *buf, unsigned len)
+{
+    exe_ent *e = get_ent(id);
+    const uint8_t *src = (const uint8_t *)buf;
+
+    if (e)
+        e->image.insert(e->image.end(), src, src + len);
+}
+
+void execache_add_reloc(int id, uint16_t seg, uint16_t off)
+{
+    exe_ent *e = get_ent(id);
+
+    if (e)
+        e->relocs.push_back(((uint32_t)seg << 16) | off);
+}
+
+/* the load went fine: account the entry and make room for it */
+void execache_done(int id)
+{
+    auto m = eids.find(id);
+
+    if (m == eids.end())
+        return;
+    exe_list::iterator it = m->second;
+    pending_id = -1;
+    if (ent_bytes(*it) > max_bytes) {
+        drop_ent(it);
+        return;
+    }
+    it->done = true;
+    cur_bytes += ent_bytes(*it);
+    while (cur_bytes > max_bytes)
+        drop_ent(std::prev(elist.end()));
+}
+
+uint32_t execache_image_len(int id)
+{
+    exe_ent *e = get_ent(id);
+
+    return e ? e->image.size() : 0;
+}
+
+void execache_get(int id, uint32_t off, void *buf, unsigned len)
+{
+    exe_ent *e = get_ent(id);
+
+    if (e && off <= e->image.size() && len <= e->image.size() - off)
+        memcpy(buf, &e->image[off], len);
+}
+
+uint32_t execache_nrelocs(int id)
+{
+    exe_ent *e = get_ent(id);
+
+    return e ? e->relocs.size() : 0;
+}
+
+uint32_t execache_reloc(int id, uint32_t idx)
+{
+    exe_ent *e = get_ent(id);
+
+    return (e && idx < e->relocs.size()) ? e->relocs[idx] : 0;
+}
+
+void execache_drop(int id)
+{
+    auto m = eids.find(id);
+
+    if (m != eids.end())
+        drop_ent(m->second);
+}
+
+void execache_inval(int unit, uint32_t start)
+{
+    auto m = emap.find(mk_key(unit, start));
+
+    if (m != emap.end())
+        drop_ent(m->second);
+}
+
+void execache_inval_unit(int unit)
+{
+    auto it = emap.lower_bound(mk_key(unit, 0));
+
+    while (it != emap.end() && it->first <= mk_key(unit, UINT32_MAX)) {
+        exe_list::iterator e = it->second;
+        ++it;
+        drop_ent(e);
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXECACHE_H
+#define EXECACHE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void execache_setup(unsigned kbytes);
+int execache_enabled(void);
+int execache_find(int unit, uint32_t start, uint32_t size, uint16_t date,
+        uint16_t time);
+int execache_new(int unit, uint32_t start, uint32_t size, uint16_t date,
+        uint16_t time);
+void execache_put(int id, const void *buf, unsigned len);
+void execache_add_reloc(int id, uint16_t seg, uint16_t off);
+void execache_done(int id);
+uint32_t execache_image_len(int id);
+void execache_get(int id, uint32_t off, void *buf, unsigned len);
+uint32_t execache_nrelocs(int id);
+uint32_t execache_reloc(int id, uint32_t idx);
+void execache_drop(int id);
+void execache_inval(int unit, uint32_t start);
+void execache_inval_unit(int unit);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
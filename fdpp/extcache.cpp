@@ -0,0 +1,175 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* purpose: per-SFT map of the file's cluster chain, so that
+ * map_cluster() does not need to walk the FAT from the start of
+ * the file on every backward seek.
+ * The chain is stored as the runs of physically contiguous
+ * clusters, ordered by the relative cluster number. The entry
+ * also remembers the unit and the start cluster of the file, and
+ * is dropped when they do not match. */
+
+#include <map>
+#include "extcache.h"
+
+struct ext_run {
+    uint32_t clus;
+    uint32_t len;
+};
+
+struct ext_ent {
+    int unit;
+    uint32_t start;
+    std::map<uint32_t, ext_run> runs;
+};
+
+static std::map<int, ext_ent> ecache;
+
+static ext_ent *get_ent(int idx, int unit, uint32_t start)
+{
+    auto it = ecache.find(idx);
+
+    if (it == ecache.end())
+        return nullptr;
+    if (it->second.unit != unit || it->second.start != start) {
+        ecache.erase(it);
+        return nullptr;
+    }
+    return &it->second;
+}
+
+/* find the run that covers rel, or the closest one below it */
+static std::map<uint32_t, ext_run>::iterator find_run(ext_ent *e,
+        uint32_t rel)
+{
+    auto it = e->runs.upper_bound(rel);
+
+    if (it == e->runs.begin())
+        return e->runs.end();
+    return --it;
+}
+
+void extcache_add(int idx, int unit, uint32_t start, uint32_t rel,
+        uint32_t clus)
+{
+    ext_ent *e = get_ent(idx, unit, start);
+
+    if (!e) {
+        e = &ecache[idx];
+        e->unit = unit;
+        e->start = start;
+    }
+    auto it = find_run(e, rel);
+    if (it != e->runs.end()) {
+        ext_run &r = it->second;
+        uint32_t off = rel - it->first;
+
+        if (off < r.len) {
+            if (r.clus + off == clus)
+                return;
+            /* chain was changed behind our back, forget the rest */
+            r.len = off;
+            e->runs.erase(std::next(it), e->runs.end());
+            if (!r.len)
+                e->runs.erase(it);
+        } else if (off == r.len && r.clus + off == clus) {
+            r.len++;
+            auto nx = std::next(it);
+            /* merge with the next run if they now touch */
+            if (nx != e->runs.end() && nx->first == rel + 1 &&
+                    nx->second.clus == clus + 1) {
+                r.len += nx->second.len;
+                e->runs.erase(nx);
+            }
+            return;
+        }
+    }
+    auto nx = e->runs.upper_bound(rel);
+    if (nx != e->runs.end() && nx->first == rel + 1 &&
+            nx->second.clus == clus + 1) {
+        ext_run r = { clus, nx->second.len + 1 };
+        e->runs.erase(nx);
+        e->runs[rel] = r;
+        return;
+    }
+    e->runs[rel] = { clus, 1 };
+}
+
+/* in: *rel is the wanted relative cluster.
+ * out: the closest known relative cluster at or below it, and
+ * its physical cluster. Returns 0 if nothing is known. */
+int extcache_find(int idx, int unit, uint32_t start, uint32_t *rel,
+        uint32_t *clus)
+{
+    ext_ent *e = get_ent(idx, unit, start);
+
+    if (!e)
+        return 0;
+    auto it = find_run(e, *rel);
+    if (it == e->runs.end())
+        return 0;
+    uint32_t off = *rel - it->first;
+    if (off >= it->second.len)
+        off = it->second.len - 1;
+    *rel = it->first + off;
+    *clus = it->second.clus + off;
+    return 1;
+}
+
+/* the file starting at start now ends before rel: drop the tail
+ * from every handle that maps it */
+void extcache_trunc(int unit, uint32_t start, uint32_t rel)
+{
+    for (auto it = ecache.begin(); it != ecache.end();) {
+        ext_ent &e = it->second;
+
+        if (e.unit != unit || e.start != start) {
+            ++it;
+            continue;
+        }
+        if (!rel) {
+            it = ecache.erase(it);
+            continue;
+        }
+        e.runs.erase(e.runs.lower_bound(rel), e.runs.end());
+        auto r = find_run(&e, rel);
+        if (r != e.runs.end() && rel - r->first < r->second.len)
+            r->second.len = rel - r->first;
+        ++it;
+    }
+}
+
+void extcache_del(int idx)
+{
+    ecache.erase(idx);
+}
+
+void extcache_reset(void)
+{
+    ecache.clear();
+}
+
+void extcache_del_unit(int unit)
+{
+    for (auto it = ecache.begin(); it != ecache.end();) {
+        if (it->second.unit == unit)
+            it = ecache.erase(it);
+        else
+            ++it;
+    }
+}
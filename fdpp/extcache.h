@@ -0,0 +1,39 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXTCACHE_H
+#define EXTCACHE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void extcache_add(int idx, int unit, uint32_t start, uint32_t rel,
+        uint32_t clus);
+int extcache_find(int idx, int unit, uint32_t start, uint32_t *rel,
+        uint32_t *clus);
+void extcache_trunc(int unit, uint32_t start, uint32_t rel);
+void extcache_del(int idx);
+void extcache_del_unit(int unit);
+void extcache_reset(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,86 +17,87 @@
  */
 
 #include <stdlib.h>
+#include <algorithm>
 #include "portab.h"
 #include "thunks_priv.h"
 #include "farhlp.hpp"
 
 /* hackish helper to store/lookup far pointers - using static
- * object (map) is an ugly hack in an OOP world.
+ * object (table) is an ugly hack in an OOP world.
  * Need this to work around some C++ deficiencies, see comments
  * in farptr.hpp */
 
 fh1 g_farhlp1;
 fh1 g_farhlp2;
 
+static bool fm_less(const f_m &a, const f_m &b)
+{
+    return a.ptr < b.ptr || (a.ptr == b.ptr && a.id < b.id);
+}
+
+static bool fm_ptr_less(const f_m &a, const void *ptr)
+{
+    return a.ptr < ptr;
+}
+
+static bool ptr_fm_less(const void *ptr, const f_m &a)
+{
+    return ptr < a.ptr;
+}
+
 void farhlp_init(farhlp *ctx)
 {
-    ctx->map.clear();
+    ctx->tab.clear();
 }
 
-void store_far(farhlp *ctx, const void *ptr, far_t fptr)
+/* entries are appended unsorted, call farhlp_sort() when done */
+void farhlp_add(farhlp *ctx, const void *ptr, far_t fptr, int id)
 {
-    struct f_m *fm;
-    const std::pair<decltype(ctx->map)::iterator, bool> &p =
-            ctx->map.insert(std::make_pair(ptr,
-            decltype(ctx->map)::mapped_type()));
-    if (!p.second) {
-        far_t *f = &p.first->second.f;
-        _assert(f->seg == fptr.seg && f->off == fptr.off);
-        /* already exists, do nothing */
-        return;
-    }
-    fm = &p.first->second;
-    fm->f = fptr;
-    fm->refcnt = 1;
+    ctx->tab.push_back({ ptr, fptr, id });
 }
 
-void store_far_replace(farhlp *ctx, const void *ptr, far_t fptr)
+void farhlp_sort(farhlp *ctx)
 {
-    struct f_m *fm = &ctx->map[ptr];
-    fm->f = fptr;
-    fm->refcnt = 1;
+    std::sort(ctx->tab.begin(), ctx->tab.end(), fm_less);
 }
 
 far_t lookup_far(farhlp *ctx, const void *ptr)
 {
-    decltype(ctx->map)::iterator it = ctx->map.find(ptr);
+    decltype(ctx->tab)::iterator it = std::upper_bound(ctx->tab.begin(),
+            ctx->tab.end(), ptr, ptr_fm_less);
 
-    if (it == ctx->map.end())
+    if (it == ctx->tab.begin() || (--it)->ptr != ptr)
         return (far_t){0, 0};
-    return it->second.f;
+    return it->f;
 }
 
-far_t lookup_far_ref(farhlp *ctx, const void *ptr)
+/* entries with start <= ptr <= end */
+int farhlp_range(farhlp *ctx, const void *start, const void *end,
+        int *first)
 {
-    struct f_m *fm;
-    decltype(ctx->map)::iterator it = ctx->map.find(ptr);
+    decltype(ctx->tab)::iterator b = std::lower_bound(ctx->tab.begin(),
+            ctx->tab.end(), start, fm_ptr_less);
+    decltype(ctx->tab)::iterator e = std::upper_bound(b,
+            ctx->tab.end(), end, ptr_fm_less);
 
-    if (it == ctx->map.end())
-        return (far_t){0, 0};
-    fm = &it->second;
-    fm->refcnt++;
-    return fm->f;
+    *first = b - ctx->tab.begin();
+    return e - b;
 }
 
-far_t lookup_far_unref(farhlp *ctx, const void *ptr, int *rm)
+/* The caller has updated ptr/f of the entries in the range. Move them
+ * to their new place: the range is sorted on its own and merged back,
+ * which is linear rather than a full re-sort. */
+void farhlp_rebase(farhlp *ctx, int first, int num)
 {
-    struct f_m *fm;
-    far_t ret;
-    int r;
-    decltype(ctx->map)::iterator it = ctx->map.find(ptr);
+    decltype(ctx->tab)::iterator b = ctx->tab.begin() + first;
+    decltype(ctx->tab)::iterator end = ctx->tab.end();
 
-    if (it == ctx->map.end())
-        return (far_t){0, 0};
-    fm = &it->second;
-    ret = fm->f;
-    fm->refcnt--;
-    r = 0;
-    if (!fm->refcnt) {
-        r = 1;
-        ctx->map.erase(it);
-    }
-    if (rm)
-        *rm = r;
-    return ret;
+    std::rotate(b, b + num, end);
+    std::sort(end - num, end, fm_less);
+    std::inplace_merge(ctx->tab.begin(), end - num, end, fm_less);
+}
+
+void farhlp_erase(farhlp *ctx, int first, int num)
+{
+    ctx->tab.erase(ctx->tab.begin() + first, ctx->tab.begin() + first + num);
 }
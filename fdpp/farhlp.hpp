@@ -19,14 +19,18 @@
 #ifndef FARHLP_HPP
 #define FARHLP_HPP
 
-#include <unordered_map>
+#include <vector>
 
+/* One entry per symbol, the table is kept sorted by (ptr, id).
+ * Several symbols may resolve to the same address, the one with
+ * the highest id wins on lookup. */
 struct f_m {
+    const void *ptr;
     far_t f;
-    int refcnt;
+    int id;
 };
 struct farhlp {
-    std::unordered_map<const void *, struct f_m> map;
+    std::vector<f_m> tab;
 };
 
 struct fh1 {
@@ -37,10 +41,12 @@ extern fh1 g_farhlp1;
 extern fh1 g_farhlp2;
 
 void farhlp_init(farhlp *ctx);
-void store_far(farhlp *ctx, const void *ptr, far_t fptr);
-void store_far_replace(farhlp *ctx, const void *ptr, far_t fptr);
+void farhlp_add(farhlp *ctx, const void *ptr, far_t fptr, int id);
+void farhlp_sort(farhlp *ctx);
 struct far_s lookup_far(farhlp *ctx, const void *ptr);
-struct far_s lookup_far_ref(farhlp *ctx, const void *ptr);
-struct far_s lookup_far_unref(farhlp *ctx, const void *ptr, int *rm);
+int farhlp_range(farhlp *ctx, const void *start, const void *end,
+        int *first);
+void farhlp_rebase(farhlp *ctx, int first, int num);
+void farhlp_erase(farhlp *ctx, int first, int num);
 
 #endif
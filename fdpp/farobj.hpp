@@ -52,17 +52,15 @@ template <typename T>
 class FarObj : public FarObjBase<T>, public ObjIf, public ObjRef {
     bool have_obj = false;
     bool is_const = false;
-    const char *err_msg = "error: leaked object";
-    std::string msg;
-    ctor_log ct;
+    ctor_tmp ct;
     int refcnt = 0;
     std::unordered_set<ObjRef *> owned;
     std::unordered_set<sh_ref> owned_sh;
 
     void _ctor() {
         this->fobj = (__DOSFAR(uint8_t))mk_dosobj(this->ptr, this->size);
-        owned = get_owned_list(this->ptr);
-        owned_sh = get_owned_list_sh(this->ptr);
+        get_owned_list(this->ptr, owned);
+        get_owned_list_sh(this->ptr, owned_sh);
     }
 
     template <typename T1 = T,
@@ -104,8 +102,7 @@ public:
         typename std::enable_if<!std::is_void<T1>::value &&
             !std::is_pointer<T1>::value>::type* = nullptr>
     FarObj(T1& obj, const char *nm) : FarObjBase<T>(&obj, sizeof(T1)),
-            msg(std::string(nm) + std::string(": ") + std::string(err_msg)),
-            ct(msg) {
+            ct(nm) {
         _ctor();
     }
     FarObj(T* obj, unsigned sz, bool cst, const char *nm) :
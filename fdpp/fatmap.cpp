@@ -0,0 +1,275 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* purpose: host copy of the FAT of every mounted unit, with a
+ * bitmap of its free clusters.
+ * The FAT is loaded once, after which link_fat() reads the entries
+ * from here and mirrors every write, so chain walks, allocation and
+ * the free space query do not go through the DOS buffers.
+ * A set bit in the bitmap means a free cluster. */
+
+#include <cstring>
+#include <map>
+#include <vector>
+#include "fatmap.h"
+
+/* do not keep the FATs of huge volumes */
+#define MAX_IMAGE (64 * 1024 * 1024)
+
+struct fat_map {
+    uint32_t max_cluster;
+    unsigned fatbits;
+    uint32_t nfree;
+    int ready;
+    std::vector<uint8_t> img;
+    std::vector<uint64_t> bits;
+};
+
+static std::map<int, fat_map> fmaps;
+
+static fat_map *get_map(int unit)
+{
+    auto it = fmaps.find(unit);
+
+    if (it == fmaps.end() || !it->second.ready)
+        return nullptr;
+    return &it->second;
+}
+
+static uint32_t get_ent(const fat_map *m, uint32_t clus)
+{
+    const uint8_t *p;
+    uint16_t v16;
+    uint32_t v;
+
+    switch (m->fatbits) {
+    case 12:
+        p = &m->img[clus + clus / 2];
+        v16 = p[0] | (p[1] << 8);
+        return (clus & 1) ? v16 >> 4 : v16 & 0xfff;
+    case 16:
+        memcpy(&v16, &m->img[clus * 2], 2);
+        return v16;
+    default:
+        memcpy(&v, &m->img[clus * 4], 4);
+        return v & 0x0fffffff;
+    }
+}
+
+static void put_ent(fat_map *m, uint32_t clus, uint32_t val)
+{
+    uint8_t *p;
+    uint16_t v16;
+    uint32_t v;
+
+    switch (m->fatbits) {
+    case 12:
+        p = &m->img[clus + clus / 2];
+        v16 = p[0] | (p[1] << 8);
+        if (clus & 1)
+            v16 = (v16 & 0x000f) | ((val & 0xfff) << 4);
+        else
+            v16 = (v16 & 0xf000) | (val & 0xfff);
+        p[0] = v16 & 0xff;
+        p[1] = v16 >> 8;
+        break;
+    case 16:
+        v16 = val;
+        memcpy(&m->img[clus * 2], &v16, 2);
+        break;
+    default:
+        /* the upper 4 bits are reserved and must be preserved */
+        memcpy(&v, &m->img[clus * 4], 4);
+        v = (v & 0xf0000000) | (val & 0x0fffffff);
+        memcpy(&m->img[clus * 4], &v, 4);
+        break;
+    }
+}
+
+static void set_bit(fat_map *m, uint32_t clus, int is_free)
+{
+    uint64_t mask = 1ULL << (clus & 63);
+    uint64_t &w = m->bits[clus >> 6];
+
+    if (!!(w & mask) == !!is_free)
+        return;
+    w ^= mask;
+    if (is_free)
+        m->nfree++;
+    else
+        m->nfree--;
+}
+
+int fatmap_valid(int unit)
+{
+    return !!get_map(unit);
+}
+
+/* returns the number of FAT bytes to load, 0 if the FAT is too big */
+uint32_t fatmap_init(int unit, uint32_t max_cluster, unsigned fatbits)
+{
+    uint64_t size;
+
+    fmaps.erase(unit);
+    switch (fatbits) {
+    case 12:
+        /* one spare byte, so that the last entry can be read as a word */
+        size = (uint64_t)(max_cluster + 1) * 3 / 2 + 1;
+        break;
+    case 16:
+        size = (uint64_t)(max_cluster + 1) * 2;
+        break;
+    default:
+        size = (uint64_t)(max_cluster + 1) * 4;
+        break;
+    }
+    if (size > MAX_IMAGE)
+        return 0;
+
+    fat_map &m = fmaps[unit];
+    m.max_cluster = max_cluster;
+    m.fatbits = fatbits;
+    m.nfree = 0;
+    m.ready = 0;
+    m.img.assign(size, 0);
+    m.bits.assign(max_cluster / 64 + 1, 0);
+    return size;
+}
+
+void fatmap_load(int unit, uint32_t off, const void *buf, unsigned len)
+{
+    auto it = fmaps.find(unit);
+
+    if (it == fmaps.end() || off >= it->second.img.size())
+        return;
+    fat_map &m = it->second;
+    if (len > m.img.size() - off)
+        len = m.img.size() - off;
+    memcpy(&m.img[off], buf, len);
+}
+
+/* all of the FAT is loaded: build the bitmap. FAT16/32 entries are
+ * tested 8 bytes at a time, so that the used areas and the free
+ * ones are both skipped quickly. */
+void fatmap_done(int unit)
+{
+    auto it = fmaps.find(unit);
+    uint32_t clus = 2;
+
+    if (it == fmaps.end())
+        return;
+    fat_map &m = it->second;
+    if (m.fatbits != 12) {
+        unsigned width = m.fatbits / 8;
+        unsigned per = 8 / width;
+
+        /* the first word also covers the reserved entries */
+        for (clus = per; clus + per - 1 <= m.max_cluster; clus += per) {
+            uint64_t w;
+
+            memcpy(&w, &m.img[clus * width], 8);
+            if (w == 0) {
+                for (unsigned j = 0; j < per; j++)
+                    set_bit(&m, clus + j, 1);
+                continue;
+            }
+            for (unsigned j = 0; j < per; j++) {
+                if (!get_ent(&m, clus + j))
+                    set_bit(&m, clus + j, 1);
+            }
+        }
+        for (unsigned j = 2; j < per; j++) {
+            if (!get_ent(&m, j))
+                set_bit(&m, j, 1);
+        }
+    }
+    for (; clus <= m.max_cluster; clus++) {
+        if (!get_ent(&m, clus))
+            set_bit(&m, clus, 1);
+    }
+    m.ready = 1;
+}
+
+int fatmap_get(int unit, uint32_t clus, uint32_t *val)
+{
+    fat_map *m = get_map(unit);
+
+    if (!m || clus > m->max_cluster)
+        return 0;
+    *val = get_ent(m, clus);
+    return 1;
+}
+
+void fatmap_set(int unit, uint32_t clus, uint32_t val)
+{
+    fat_map *m = get_map(unit);
+
+    if (!m || clus < 2 || clus > m->max_cluster)
+        return;
+    put_ent(m, clus, val);
+    set_bit(m, clus, get_ent(m, clus) == 0);
+}
+
+static uint32_t find_range(fat_map *m, uint32_t from, uint32_t to)
+{
+    uint32_t idx = from >> 6;
+    uint64_t w = m->bits[idx] & (~0ULL << (from & 63));
+
+    for (;;) {
+        if (w) {
+            uint32_t clus = (idx << 6) + __builtin_ctzll(w);
+            return clus <= to ? clus : 0;
+        }
+        if (++idx > (to >> 6))
+            return 0;
+        w = m->bits[idx];
+    }
+}
+
+/* first free cluster at or after from, wrapping to 2; 0 if none */
+uint32_t fatmap_find(int unit, uint32_t from)
+{
+    fat_map *m = get_map(unit);
+    uint32_t clus;
+
+    if (!m || !m->nfree)
+        return 0;
+    if (from < 2 || from > m->max_cluster)
+        from = 2;
+    clus = find_range(m, from, m->max_cluster);
+    if (!clus && from > 2)
+        clus = find_range(m, 2, from - 1);
+    return clus;
+}
+
+uint32_t fatmap_count(int unit)
+{
+    fat_map *m = get_map(unit);
+
+    return m ? m->nfree : 0;
+}
+
+void fatmap_del_unit(int unit)
+{
+    fmaps.erase(unit);
+}
+
+void fatmap_reset(void)
+{
+    fmaps.clear();
+}
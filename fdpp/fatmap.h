@@ -0,0 +1,41 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FATMAP_H
+#define FATMAP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int fatmap_valid(int unit);
+uint32_t fatmap_init(int unit, uint32_t max_cluster, unsigned fatbits);
+void fatmap_load(int unit, uint32_t off, const void *buf, unsigned len);
+void fatmap_done(int unit);
+int fatmap_get(int unit, uint32_t clus, uint32_t *val);
+void fatmap_set(int unit, uint32_t clus, uint32_t val);
+uint32_t fatmap_find(int unit, uint32_t from);
+uint32_t fatmap_count(int unit);
+void fatmap_del_unit(int unit);
+void fatmap_reset(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -31,14 +31,15 @@ bool track_owner(const void *owner, ObjRef *obj)
     return ent.insert(obj).second;
 }
 
-std::unordered_set<ObjRef *> get_owned_list(const void *owner)
+void get_owned_list(const void *owner, std::unordered_set<ObjRef *> &ret)
 {
-    std::unordered_set<ObjRef *> ret;
-    if (omap.find(owner) != omap.end()) {
-        ret = omap[owner];
-        omap.erase(owner);
+    if (omap.empty())
+        return;
+    auto it = omap.find(owner);
+    if (it != omap.end()) {
+        ret = std::move(it->second);
+        omap.erase(it);
     }
-    return ret;
 }
 
 typedef std::unordered_map<const void *, sh_ref> refmap;
@@ -53,17 +54,18 @@ bool track_owner_sh(const void *owner, const void *loc, sh_ref obj)
     return ret;
 }
 
-std::unordered_set<sh_ref> get_owned_list_sh(const void *owner)
+void get_owned_list_sh(const void *owner, std::unordered_set<sh_ref> &ret)
 {
-    std::unordered_set<sh_ref> ret;
-    if (shmap.find(owner) != shmap.end()) {
-        refmap& ent = shmap[owner];
+    if (shmap.empty())
+        return;
+    auto it = shmap.find(owner);
+    if (it != shmap.end()) {
+        refmap& ent = it->second;
         std::for_each(ent.begin(), ent.end(), [&ret] (refmap::value_type& ref) {
             ret.insert(ref.second);
         });
-        shmap.erase(owner);
+        shmap.erase(it);
     }
-    return ret;
 }
 
 void objhlp_reset()
@@ -29,11 +29,11 @@ public:
 };
 
 bool track_owner(const void *owner, ObjRef *obj);
-std::unordered_set<ObjRef *> get_owned_list(const void *owner);
+void get_owned_list(const void *owner, std::unordered_set<ObjRef *> &ret);
 
 typedef std::shared_ptr<ObjRef> sh_ref;
 bool track_owner_sh(const void *owner, const void *loc, sh_ref obj);
-std::unordered_set<sh_ref> get_owned_list_sh(const void *owner);
+void get_owned_list_sh(const void *owner, std::unordered_set<sh_ref> &ret);
 void objhlp_reset();
 
 #endif
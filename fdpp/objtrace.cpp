@@ -22,6 +22,7 @@
 #include "portab.h"
 #include "dosobj.h"
 #include "objtrace.hpp"
+#include "thunks.h"
 
 struct gc_s {
     int mark = 0;
@@ -47,7 +48,7 @@ void objtrace_enter()
     });
     gc.list.clear();
     if (cnt)
-        fdlogprintf("gc'ed %i objects\n", cnt);
+        fdlog(FDPP_LOG_OBJ, "gc'ed %i objects\n", cnt);
 }
 
 void objtrace_leave()
@@ -0,0 +1,85 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* purpose: per-SFT detection of sequential reads for rwblock().
+ * A handle is streaming while every read starts where the previous
+ * one ended. The read-ahead window starts small and doubles each
+ * time it is refilled, up to the configured maximum; any seek
+ * resets it. */
+
+#include <map>
+#include "readahead.h"
+
+#define MIN_WINDOW 4
+
+struct ra_state {
+    uint32_t last_end;
+    uint32_t pf_end;
+    unsigned win;
+};
+
+static std::map<int, ra_state> rstate;
+
+/* note a read of len bytes at off, returns 1 if the handle streams */
+int ra_note(int idx, uint32_t off, unsigned len)
+{
+    ra_state &st = rstate[idx];
+    int seq = (off == st.last_end);
+
+    if (!seq) {
+        st.win = 0;
+        st.pf_end = 0;
+    }
+    st.last_end = off + len;
+    return seq;
+}
+
+/* sectors to read ahead from off, 0 if off is already covered */
+unsigned ra_window(int idx, uint32_t off, unsigned max)
+{
+    auto it = rstate.find(idx);
+
+    if (it == rstate.end())
+        return 0;
+    ra_state &st = it->second;
+    if (off < st.pf_end)
+        return 0;
+    st.win = st.win ? st.win * 2 : MIN_WINDOW;
+    if (st.win > max)
+        st.win = max;
+    return st.win;
+}
+
+/* data up to the file offset end is now in the cache */
+void ra_mark(int idx, uint32_t end)
+{
+    auto it = rstate.find(idx);
+
+    if (it != rstate.end())
+        it->second.pf_end = end;
+}
+
+void ra_del(int idx)
+{
+    rstate.erase(idx);
+}
+
+void ra_reset(void)
+{
+    rstate.clear();
+}
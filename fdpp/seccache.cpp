@@ -0,0 +1,314 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* purpose: second-level sector cache below dskxfer(), in host memory.
+ * Clean sectors are kept on an LRU list and evicted when the unit's
+ * cache is full. In write-back mode, dirty sectors are kept on a
+ * separate list and are never evicted: the kernel writes them out
+ * with seccache_next_dirty() and seccache_clean(). */
+
+#include <list>
+#include <iterator>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include "portab.h"
+#include "thunks_priv.h"
+#include "seccache.h"
+
+struct sec_ent {
+    uint32_t blkno;
+    bool dirty;
+    std::vector<uint8_t> data;
+};
+
+typedef std::list<sec_ent> sec_list;
+
+struct unit_cache {
+    sec_list clean;     // front is most recently used
+    sec_list dirty;
+    std::unordered_map<uint32_t, sec_list::iterator> map;
+    size_t bytes = 0;
+};
+
+static std::unordered_map<int, unit_cache> ucache;
+static size_t max_bytes;
+static int wb_mode;
+
+static size_t dirty_total(void)
+{
+    size_t cnt = 0;
+
+    for (auto &u : ucache)
+        cnt += u.second.dirty.size();
+    return cnt;
+}
+
+static void drop_all(const char *why)
+{
+    size_t cnt = dirty_total();
+
+    if (cnt)
+        fdloudprintf("seccache: %zu delayed sectors lost on %s\n", cnt, why);
+    ucache.clear();
+}
+
+/* the kernel writes dirty sectors out before changing the setup */
+void seccache_setup(unsigned mbytes, int wback)
+{
+    drop_all("setup");
+    max_bytes = (size_t)mbytes << 20;
+    wb_mode = wback;
+}
+
+/* called at boot: the kernel that owned the dirty sectors is gone,
+ * so they can only be reported. int 19h flushes them on a normal
+ * reboot, the host should check FdppSecCacheDirty() and do a disk
+ * reset before it tears the machine down otherwise. */
+void seccache_reset(void)
+{
+    drop_all("reset");
+    max_bytes = 0;
+    wb_mode = 0;
+}
+
+int seccache_dirty_total(void)
+{
+    return dirty_total();
+}
+
+int seccache_enabled(void)
+{
+    return !!max_bytes;
+}
+
+static void drop_ent(unit_cache &uc, sec_list::iterator it)
+{
+    uc.bytes -= it->data.size();
+    uc.map.erase(it->blkno);
+    if (it->dirty)
+        uc.dirty.erase(it);
+    else
+        uc.clean.erase(it);
+}
+
+static void shrink(unit_cache &uc)
+{
+    while (uc.bytes > max_bytes && !uc.clean.empty())
+        drop_ent(uc, std::prev(uc.clean.end()));
+}
+
+static sec_list::iterator find_ent(unit_cache &uc, uint32_t blkno,
+        unsigned secsize)
+{
+    auto m = uc.map.find(blkno);
+
+    if (m == uc.map.end())
+        return uc.clean.end();
+    if (m->second->data.size() != secsize) {
+        /* bpb_to_dpb() and setinvld() flush before secsize changes */
+        _assert(!m->second->dirty);
+        drop_ent(uc, m->second);
+        return uc.clean.end();
+    }
+    return m->second;
+}
+
+static void touch(unit_cache &uc, sec_list::iterator it)
+{
+    if (!it->dirty)
+        uc.clean.splice(uc.clean.begin(), uc.clean, it);
+}
+
+static void store_one(unit_cache &uc, uint32_t blkno, const uint8_t *src,
+        unsigned secsize, bool dirty)
+{
+    sec_list::iterator it = find_ent(uc, blkno, secsize);
+
+    if (it == uc.clean.end()) {
+        sec_list &l = dirty ? uc.dirty : uc.clean;
+        l.push_front(sec_ent());
+        it = l.begin();
+        it->blkno = blkno;
+        it->dirty = dirty;
+        it->data.resize(secsize);
+        uc.map[blkno] = it;
+        uc.bytes += secsize;
+    } else if (it->dirty != dirty) {
+        if (dirty)
+            uc.dirty.splice(uc.dirty.begin(), uc.clean, it);
+        else
+            uc.clean.splice(uc.clean.begin(), uc.dirty, it);
+        it->dirty = dirty;
+    } else {
+        touch(uc, it);
+    }
+    memcpy(it->data.data(), src, secsize);
+}
+
+int seccache_read(int unit, uint32_t blkno, void *buf, unsigned num,
+        unsigned secsize)
+{
+    unsigned i;
+    uint8_t *dst = (uint8_t *)buf;
+
+    if (!max_bytes)
+        return 0;
+    unit_cache &uc = ucache[unit];
+    for (i = 0; i < num; i++) {
+        if (find_ent(uc, blkno + i, secsize) == uc.clean.end())
+            return 0;
+    }
+    for (i = 0; i < num; i++) {
+        sec_list::iterator it = uc.map[blkno + i];
+        memcpy(dst + i * secsize, it->data.data(), secsize);
+        touch(uc, it);
+    }
+    return 1;
+}
+
+/* called after a device read: cached sectors win, as they may be dirty */
+void seccache_fill(int unit, uint32_t blkno, void *buf, unsigned num,
+        unsigned secsize)
+{
+    unsigned i;
+    uint8_t *dst = (uint8_t *)buf;
+
+    if (!max_bytes)
+        return;
+    unit_cache &uc = ucache[unit];
+    for (i = 0; i < num; i++) {
+        sec_list::iterator it = find_ent(uc, blkno + i, secsize);
+        if (it == uc.clean.end()) {
+            store_one(uc, blkno + i, dst + i * secsize, secsize, false);
+        } else {
+            memcpy(dst + i * secsize, it->data.data(), secsize);
+            touch(uc, it);
+        }
+    }
+    shrink(uc);
+}
+
+/* returns 1 if the write was absorbed by the cache */
+int seccache_write(int unit, uint32_t blkno, const void *buf, unsigned num,
+        unsigned secsize)
+{
+    unsigned i;
+    const uint8_t *src = (const uint8_t *)buf;
+
+    if (!max_bytes || !wb_mode)
+        return 0;
+    unit_cache &uc = ucache[unit];
+    /* keep at least half of the cache for clean sectors */
+    if ((uc.dirty.size() + num) * secsize > max_bytes / 2)
+        return 0;
+    for (i = 0; i < num; i++)
+        store_one(uc, blkno + i, src + i * secsize, secsize, true);
+    shrink(uc);
+    return 1;
+}
+
+void seccache_store(int unit, uint32_t blkno, const void *buf, unsigned num,
+        unsigned secsize)
+{
+    unsigned i;
+    const uint8_t *src = (const uint8_t *)buf;
+
+    if (!max_bytes)
+        return;
+    unit_cache &uc = ucache[unit];
+    for (i = 0; i < num; i++)
+        store_one(uc, blkno + i, src + i * secsize, secsize, false);
+    shrink(uc);
+}
+
+void seccache_drop(int unit, uint32_t blkno, unsigned num)
+{
+    unsigned i;
+    unit_cache &uc = ucache[unit];
+
+    for (i = 0; i < num; i++) {
+        auto m = uc.map.find(blkno + i);
+        if (m != uc.map.end())
+            drop_ent(uc, m->second);
+    }
+}
+
+int seccache_dirty(int unit)
+{
+    auto u = ucache.find(unit);
+
+    if (u == ucache.end())
+        return 0;
+    return u->second.dirty.size();
+}
+
+static bool is_dirty(unit_cache &uc, uint32_t blkno, unsigned secsize)
+{
+    auto m = uc.map.find(blkno);
+
+    return m != uc.map.end() && m->second->dirty &&
+            m->second->data.size() == secsize;
+}
+
+/* copy out the run of up to max adjacent dirty sectors around the
+ * least recently written one, returns the number of sectors */
+int seccache_next_dirty(int unit, uint32_t *blkno, void *buf,
+        unsigned max, unsigned secsize)
+{
+    auto u = ucache.find(unit);
+    sec_list::iterator it;
+    uint8_t *dst = (uint8_t *)buf;
+    uint32_t start;
+    unsigned n;
+
+    if (u == ucache.end() || u->second.dirty.empty())
+        return 0;
+    unit_cache &uc = u->second;
+    it = std::prev(uc.dirty.end());
+    _assert(it->data.size() == secsize);
+    start = it->blkno;
+    while (start > 0 && it->blkno - start < max - 1 &&
+            is_dirty(uc, start - 1, secsize))
+        start--;
+    for (n = 0; n < max && is_dirty(uc, start + n, secsize); n++)
+        memcpy(dst + n * secsize, uc.map[start + n]->data.data(), secsize);
+    *blkno = start;
+    return n;
+}
+
+void seccache_clean(int unit, uint32_t blkno, unsigned num)
+{
+    unsigned i;
+    unit_cache &uc = ucache[unit];
+
+    for (i = 0; i < num; i++) {
+        auto m = uc.map.find(blkno + i);
+
+        if (m == uc.map.end() || !m->second->dirty)
+            continue;
+        uc.clean.splice(uc.clean.begin(), uc.dirty, m->second);
+        m->second->dirty = false;
+    }
+    shrink(uc);
+}
+
+void seccache_inval(int unit)
+{
+    ucache.erase(unit);
+}
@@ -0,0 +1,49 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SECCACHE_H
+#define SECCACHE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void seccache_setup(unsigned mbytes, int wback);
+void seccache_reset(void);
+int seccache_enabled(void);
+int seccache_read(int unit, uint32_t blkno, void *buf, unsigned num,
+        unsigned secsize);
+void seccache_fill(int unit, uint32_t blkno, void *buf, unsigned num,
+        unsigned secsize);
+int seccache_write(int unit, uint32_t blkno, const void *buf, unsigned num,
+        unsigned secsize);
+void seccache_store(int unit, uint32_t blkno, const void *buf, unsigned num,
+        unsigned secsize);
+void seccache_drop(int unit, uint32_t blkno, unsigned num);
+int seccache_dirty(int unit);
+int seccache_dirty_total(void);
+int seccache_next_dirty(int unit, uint32_t *blkno, void *buf,
+        unsigned max, unsigned secsize);
+void seccache_clean(int unit, uint32_t blkno, unsigned num);
+void seccache_inval(int unit);
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -43,6 +43,9 @@ static void smerror_dummy(int prio, const char *fmt, ...)
 
 #define smerror(mp, ...) mp->smerr(3, __VA_ARGS__)
 
+#define GBITS 64
+#define gtest(g, i) (((g)->map[(i) / GBITS] >> ((i) % GBITS)) & 1)
+
 static void do_dump(struct mempool *mp, char *buf, int len)
 {
     int pos = 0;
@@ -57,6 +60,22 @@ static void do_dump(struct mempool *mp, char *buf, int len)
             mp->size - mp->avail);
     DO_PRN("Largest free area: %zi\n", smget_largest_free_area(mp));
     DO_PRN("Memory pool dump:\n");
+    if (mp->mg) {
+        struct memgran *g = mp->mg;
+        unsigned i = 0, n;
+
+        while (i < g->count) {
+            if (g->len[i]) {
+                n = g->len[i];
+                DO_PRN("\tarea: %zi bytes, used\n", n * g->gran);
+            } else {
+                for (n = 1; i + n < g->count && !gtest(g, i + n); n++);
+                DO_PRN("\tarea: %zi bytes, free\n", n * g->gran);
+            }
+            i += n;
+        }
+        return;
+    }
     for (mn = &mp->mn; mn; mn = mn->next)
         DO_PRN("\tarea: %zi bytes, %s\n",
                 mn->size, mn->used ? "used" : "free");
@@ -222,9 +241,186 @@ static struct memnode *sm_alloc_mn(struct mempool *mp, size_t size)
   return mn;
 }
 
+/*
+ * Granule mode.
+ * The pool is split into fixed-size granules and a bitmap tells which
+ * of them are used. The length of an area is stored at its first
+ * granule, so free is O(1) and no memnodes are allocated. Meant for
+ * small pools with many short-lived allocations.
+ */
+
+/* bits [sh, sh + n) of a map word, n <= GBITS - sh */
+static uint64_t gmask(unsigned sh, unsigned n)
+{
+  return (n == GBITS ? ~0ULL : ((1ULL << n) - 1)) << sh;
+}
+
+static void gset(struct memgran *g, unsigned start, unsigned n, int used)
+{
+  while (n) {
+    unsigned sh = start % GBITS;
+    unsigned k = min(n, GBITS - sh);
+    uint64_t m = gmask(sh, k);
+
+    if (used)
+      g->map[start / GBITS] |= m;
+    else
+      g->map[start / GBITS] &= ~m;
+    start += k;
+    n -= k;
+  }
+}
+
+/* number of free granules from i on, stops counting at n */
+static unsigned gfree_run(struct memgran *g, unsigned i, unsigned n)
+{
+  unsigned run = 0;
+
+  while (run < n) {
+    unsigned sh = i % GBITS;
+    uint64_t w = g->map[i / GBITS] >> sh;
+    unsigned k = GBITS - sh;
+
+    if (w) {
+      unsigned z = __builtin_ctzll(w);
+      return run + min(z, k);
+    }
+    run += k;
+    i += k;
+  }
+  return run;
+}
+
+/* first run of n free granules */
+static int gfind(struct memgran *g, unsigned n)
+{
+  unsigned i = 0, j;
+
+  while (i + n <= g->count) {
+    unsigned sh = i % GBITS;
+    uint64_t w = g->map[i / GBITS] >> sh;
+
+    if (w == (~0ULL >> sh)) {
+      /* rest of the word is used */
+      i += GBITS - sh;
+      continue;
+    }
+    if (w & 1) {
+      i += __builtin_ctzll(~w);
+      continue;
+    }
+    j = gfree_run(g, i, n);
+    if (j >= n)
+      return i;
+    i += j + 1;
+  }
+  return -1;
+}
+
+static size_t gr_largest_free_area(struct memgran *g)
+{
+  unsigned i, run = 0, best = 0;
+
+  for (i = 0; i < g->count; i++) {
+    if (gtest(g, i)) {
+      run = 0;
+      continue;
+    }
+    if (++run > best)
+      best = run;
+  }
+  return best * g->gran;
+}
+
+static int gr_index(struct mempool *mp, void *ptr)
+{
+  struct memgran *g = mp->mg;
+  unsigned char *p = (unsigned char *)ptr;
+  size_t off;
+
+  if (p < mp->mn.mem_area)
+    return -1;
+  off = p - mp->mn.mem_area;
+  if (off % g->gran || off / g->gran >= g->count ||
+      !g->len[off / g->gran])
+    return -1;
+  return off / g->gran;
+}
+
+static void *gr_alloc(struct mempool *mp, size_t size)
+{
+  struct memgran *g = mp->mg;
+  unsigned n = (size + g->gran - 1) / g->gran;
+  unsigned char *area;
+  int i;
+
+  if (!size) {
+    smerror(mp, "SMALLOC: zero-sized allocation attempted\n");
+    return NULL;
+  }
+  i = gfind(g, n);
+  if (i == -1) {
+    do_smerror(get_oom_pr(mp, size), mp,
+	    "SMALLOC: Out Of Memory on alloc, requested=%zu\n", size);
+    return NULL;
+  }
+  area = mp->mn.mem_area + i * g->gran;
+  if (!sm_commit_simple(mp, area, n * g->gran))
+    return NULL;
+  gset(g, i, n, 1);
+  g->len[i] = n;
+  return area;
+}
+
+static void gr_free(struct mempool *mp, void *ptr)
+{
+  struct memgran *g = mp->mg;
+  int i = gr_index(mp, ptr);
+  unsigned n;
+
+  if (i == -1) {
+    smerror(mp, "SMALLOC: bad pointer passed to smfree()\n");
+    return;
+  }
+  n = g->len[i];
+  sm_uncommit(mp, ptr, n * g->gran);
+  gset(g, i, n, 0);
+  g->len[i] = 0;
+}
+
+static void *gr_realloc(struct mempool *mp, void *ptr, size_t size)
+{
+  struct memgran *g = mp->mg;
+  int i = gr_index(mp, ptr);
+  size_t old;
+  void *new_ptr;
+
+  if (i == -1) {
+    smerror(mp, "SMALLOC: bad pointer passed to smrealloc()\n");
+    return NULL;
+  }
+  if (size == 0) {
+    gr_free(mp, ptr);
+    return NULL;
+  }
+  old = g->len[i] * g->gran;
+  if ((size + g->gran - 1) / g->gran == g->len[i])
+    return ptr;
+  new_ptr = gr_alloc(mp, size);
+  if (!new_ptr)
+    return NULL;
+  memcpy(new_ptr, ptr, min(old, size));
+  gr_free(mp, ptr);
+  return new_ptr;
+}
+
 void *smalloc(struct mempool *mp, size_t size)
 {
-  struct memnode *mn = sm_alloc_mn(mp, size);
+  struct memnode *mn;
+
+  if (mp->mg)
+    return gr_alloc(mp, size);
+  mn = sm_alloc_mn(mp, size);
   if (!mn)
     return NULL;
   return mn->mem_area;
@@ -235,6 +431,10 @@ void smfree(struct mempool *mp, void *ptr)
   struct memnode *mn, *pmn;
   if (!ptr)
     return;
+  if (mp->mg) {
+    gr_free(mp, ptr);
+    return;
+  }
   if (!(mn = find_mn(mp, (unsigned char *)ptr, &pmn))) {
     smerror(mp, "SMALLOC: bad pointer passed to smfree()\n");
     return;
@@ -308,6 +508,8 @@ void *smrealloc(struct mempool *mp, void *ptr, size_t size)
   struct memnode *mn, *pmn;
   if (!ptr)
     return smalloc(mp, size);
+  if (mp->mg)
+    return gr_realloc(mp, ptr, size);
   if (!(mn = find_mn(mp, (unsigned char *)ptr, &pmn))) {
     smerror(mp, "SMALLOC: bad pointer passed to smrealloc()\n");
     return NULL;
@@ -357,6 +559,27 @@ int sminit(struct mempool *mp, void *start, size_t size)
   mp->commit = NULL;
   mp->uncommit = NULL;
   mp->smerr = smerr;
+  mp->mg = NULL;
+  return 0;
+}
+
+int sminit_gran(struct mempool *mp, void *start, size_t size, size_t gran)
+{
+  struct memgran *g;
+  unsigned words;
+
+  assert(gran > 0);
+  sminit(mp, start, size);
+  g = (struct memgran *)malloc(sizeof(*g));
+  g->gran = gran;
+  g->count = size / gran;
+  words = (g->count + GBITS - 1) / GBITS;
+  g->map = (uint64_t *)calloc(words ? words : 1, sizeof(uint64_t));
+  g->len = (uint16_t *)calloc(g->count ? g->count : 1, sizeof(uint16_t));
+  /* a tail shorter than a granule is never handed out */
+  mp->size = mp->avail = g->count * gran;
+  mp->mn.size = mp->size;
+  mp->mg = g;
   return 0;
 }
 
@@ -373,6 +596,14 @@ int sminit_com(struct mempool *mp, void *start, size_t size,
 void smfree_all(struct mempool *mp)
 {
   struct memnode *mn;
+  if (mp->mg) {
+    unsigned i;
+    for (i = 0; i < mp->mg->count; i++) {
+      if (mp->mg->len[i])
+        gr_free(mp, mp->mn.mem_area + i * mp->mg->gran);
+    }
+    return;
+  }
   while (POOL_USED(mp)) {
     mn = &mp->mn;
     if (!mn->used)
@@ -389,6 +620,12 @@ int smdestroy(struct mempool *mp)
 
   smfree_all(mp);
   assert(mp->mn.size >= avail);
+  if (mp->mg) {
+    free(mp->mg->map);
+    free(mp->mg->len);
+    free(mp->mg);
+    mp->mg = NULL;
+  }
   /* return leaked size */
   return mp->mn.size - avail;
 }
@@ -402,6 +639,8 @@ size_t smget_largest_free_area(struct mempool *mp)
 {
   struct memnode *mn;
   size_t size = 0;
+  if (mp->mg)
+    return gr_largest_free_area(mp->mg);
   for (mn = &mp->mn; mn; mn = mn->next) {
     if (!mn->used && mn->size > size)
       size = mn->size;
@@ -412,6 +651,14 @@ size_t smget_largest_free_area(struct mempool *mp)
 int smget_area_size(struct mempool *mp, void *ptr)
 {
   struct memnode *mn;
+  if (mp->mg) {
+    int i = gr_index(mp, ptr);
+    if (i == -1) {
+      smerror(mp, "SMALLOC: bad pointer passed to smget_area_size()\n");
+      return -1;
+    }
+    return mp->mg->len[i] * mp->mg->gran;
+  }
   if (!(mn = find_mn(mp, (unsigned char *)ptr, NULL))) {
     smerror(mp, "SMALLOC: bad pointer passed to smget_area_size()\n");
     return -1;
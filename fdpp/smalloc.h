@@ -8,6 +8,7 @@
 #define __SMALLOC_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifndef FORMAT
 #define FORMAT(T,A,B) __attribute__((format(T,A,B)))
@@ -20,10 +21,21 @@ struct memnode {
   unsigned char *mem_area;
 };
 
+/* granule mode: the pool is split into fixed granules tracked by
+ * a bitmap, see sminit_gran(). Unlike the list mode, areas are not
+ * zeroed: the owner fills them before use. */
+struct memgran {
+  size_t gran;
+  unsigned count;
+  uint64_t *map;
+  uint16_t *len;	/* granules of the area starting here, 0 if none */
+};
+
 typedef struct mempool {
   size_t size;
   size_t avail;
   struct memnode mn;
+  struct memgran *mg;
   int (*commit)(void *area, size_t size);
   int (*uncommit)(void *area, size_t size);
   void (*smerr)(int prio, const char *fmt, ...) FORMAT(printf, 2, 3);
@@ -39,6 +51,7 @@ int sminit(struct mempool *mp, void *start, size_t size);
 int sminit_com(struct mempool *mp, void *start, size_t size,
     int (*commit)(void *area, size_t size),
     int (*uncommit)(void *area, size_t size));
+int sminit_gran(struct mempool *mp, void *start, size_t size, size_t gran);
 void smfree_all(struct mempool *mp);
 int smdestroy(struct mempool *mp);
 size_t smget_free_space(struct mempool *mp);
@@ -0,0 +1,178 @@
+/*
+ *  FDPP - freedos port to modern C++
+ *  Copyright (C) 2019  Stas Sergeev (stsp)
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* purpose: compare the list and the granule modes of smalloc on a
+ * dosobj-like workload. Objects are allocated in nested frames, as
+ * FarObj temporaries are around nested thunk calls, and are freed
+ * when their frame ends. Reports the time per alloc/free pair and
+ * the smallest pool that serves the whole trace in each mode.
+ * Build with "make smbench". */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "smalloc.h"
+
+#define MAX_DEPTH 4
+#define MAX_PER_FRAME 3
+#define MAX_LIVE (MAX_DEPTH * MAX_PER_FRAME)
+#define TRACE_LEN 200000
+#define BENCH_POOL 1024
+#define BENCH_RUNS 10
+
+/* sizes of the objects the kernel passes to DOS space: words and
+ * dwords, dmatch, request headers, dir entries, SFTs, path buffers */
+static const unsigned obj_sizes[] = { 1, 2, 2, 4, 4, 11, 21, 22, 30, 32,
+    32, 59, 67, 128 };
+#define NSIZES (sizeof(obj_sizes) / sizeof(obj_sizes[0]))
+
+/* an event > 0 allocates that many bytes, 0 ends the current frame,
+ * -1 starts a new one */
+static int trace[TRACE_LEN];
+static int trace_len;
+
+static void mk_trace(unsigned seed)
+{
+    int depth = 0;
+
+    srand(seed);
+    while (trace_len < TRACE_LEN - MAX_DEPTH * (MAX_PER_FRAME + 1)) {
+        if (depth < MAX_DEPTH && (depth == 0 || rand() % 2)) {
+            int i, n = 1 + rand() % MAX_PER_FRAME;
+
+            trace[trace_len++] = -1;
+            for (i = 0; i < n; i++)
+                trace[trace_len++] = obj_sizes[rand() % NSIZES];
+            depth++;
+        } else {
+            trace[trace_len++] = 0;
+            depth--;
+        }
+    }
+    while (depth--)
+        trace[trace_len++] = 0;
+}
+
+/* run the trace, returns the number of allocations or -1 on OOM */
+static long run(struct mempool *mp)
+{
+    void *live[MAX_LIVE];
+    int mark[MAX_DEPTH];
+    int nlive = 0, depth = 0, i;
+    long cnt = 0;
+
+    for (i = 0; i < trace_len; i++) {
+        if (trace[i] == -1) {
+            mark[depth++] = nlive;
+        } else if (trace[i] == 0) {
+            depth--;
+            while (nlive > mark[depth])
+                smfree(mp, live[--nlive]);
+        } else {
+            live[nlive] = smalloc(mp, trace[i]);
+            if (!live[nlive]) {
+                while (nlive)
+                    smfree(mp, live[--nlive]);
+                return -1;
+            }
+            nlive++;
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+static void init(struct mempool *mp, void *buf, size_t size, int gran)
+{
+    if (gran)
+        sminit_gran(mp, buf, size, gran);
+    else
+        sminit(mp, buf, size);
+}
+
+/* best of BENCH_RUNS, to filter out the noise of the machine */
+static double bench(int gran)
+{
+    static unsigned char buf[BENCH_POOL];
+    double best = -1;
+    int i;
+
+    for (i = 0; i < BENCH_RUNS; i++) {
+        struct mempool mp;
+        struct timespec t0, t1;
+        double ns;
+        long cnt;
+
+        init(&mp, buf, sizeof(buf), gran);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        cnt = run(&mp);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        smdestroy(&mp);
+        if (cnt <= 0)
+            return -1;
+        ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / cnt;
+        if (best < 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+static size_t min_pool(int gran)
+{
+    static unsigned char buf[BENCH_POOL];
+    size_t lo = 1, hi = BENCH_POOL;
+
+    /* first-fit is not monotonic in the pool size in theory, but is
+     * close enough for sizing */
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        struct mempool mp;
+        long cnt;
+
+        init(&mp, buf, mid, gran);
+        cnt = run(&mp);
+        smdestroy(&mp);
+        if (cnt < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int main(int argc, char *argv[])
+{
+    static const int grans[] = { 0, 2, 4, 8 };
+    unsigned seed = argc > 1 ? atoi(argv[1]) : 1;
+    unsigned i;
+
+    mk_trace(seed);
+    printf("%-8s %12s %10s\n", "mode", "ns/alloc", "min pool");
+    for (i = 0; i < sizeof(grans) / sizeof(grans[0]); i++) {
+        char name[16];
+
+        if (grans[i])
+            snprintf(name, sizeof(name), "gran %i", grans[i]);
+        else
+            strcpy(name, "list");
+        printf("%-8s %12.1f %10zu\n", name, bench(grans[i]),
+                min_pool(grans[i]));
+    }
+    return 0;
+}
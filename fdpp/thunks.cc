@@ -19,6 +19,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <new>
+#include <vector>
 #include "../hdr/portab.h"
 #include "globals.h"
 #include "proto.h"
@@ -27,8 +30,11 @@
 #include "objtrace.hpp"
 #include "thunks_priv.h"
 #include "thunks.h"
+#include "seccache.h"
 
 static struct fdpp_api *fdpp;
+static const uint32_t no_log = 0;
+const uint32_t *fdlog_mask = &no_log;
 
 struct asm_dsc_s {
     UWORD num;
@@ -37,10 +43,128 @@ struct asm_dsc_s {
 };
 struct asm_dsc_s *asm_tab;
 static int asm_tab_len;
+/* direct-indexed by thunk number: asm_tab index, or -1 */
+static int *asm_idx;
+static int asm_idx_len;
+/* parallel to asm_tab: index of near wrapper in its segment, or -1 */
+static int *asm_wrp;
+static uint32_t *asm_cnt;
 static farhlp sym_tab;
 static struct far_s *near_wrp;
 static int num_wrps;
 static int recur_cnt;
+static uint32_t heap_calls;
+static uint32_t heap_allocs;
+static uint32_t heap_max;
+
+#ifdef FDPP_ALLOC_STATS
+/* count every host heap allocation made by C++ code of the library */
+static uint32_t alloc_cnt;
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size ?: 1);
+    if (!p)
+        throw std::bad_alloc();
+    alloc_cnt++;
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+#define ALLOC_CNT alloc_cnt
+#else
+#define ALLOC_CNT 0
+#endif
+
+static struct fdpp_trace_ent *trace_ring;
+static unsigned trace_size;     /* power of 2 */
+static unsigned trace_head;
+static unsigned trace_tail;
+static uint32_t trace_lost;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void trace_ev(int fn, int leave)
+{
+    struct fdpp_trace_ent *e;
+
+    if (trace_head - trace_tail == trace_size) {
+        trace_lost++;
+        return;
+    }
+    e = &trace_ring[trace_head & (trace_size - 1)];
+    e->ts = now_ns();
+    e->fn = fn;
+    e->depth = recur_cnt;
+    e->leave = leave;
+    trace_head++;
+}
+
+static int prof_on;
+/* indexed by FDPP_PROF_*, then by thunk number or AH */
+static std::vector<struct fdpp_prof_ent> prof_tab[FDPP_PROF_MAX];
+
+struct i21_frame {
+    uint8_t ah;
+    int depth;
+    uint64_t t0;
+};
+static std::vector<struct i21_frame> i21_stk;
+
+static void prof_add(int kind, int num, uint64_t t0, int noret)
+{
+    std::vector<struct fdpp_prof_ent> &t = prof_tab[kind];
+    struct fdpp_prof_ent *e;
+    uint64_t ns = now_ns() - t0;
+
+    if ((unsigned)num >= t.size())
+        t.resize(num + 1);
+    e = &t[num];
+    e->calls++;
+    if (noret)
+        e->noret++;
+    e->total_ns += ns;
+    if (ns > e->max_ns)
+        e->max_ns = ns;
+}
+
+void fdprof_int21_enter(uint8_t ah)
+{
+    if (!prof_on)
+        return;
+    i21_stk.push_back({ ah, recur_cnt, now_ns() });
+}
+
+void fdprof_int21_leave(void)
+{
+    if (!prof_on || i21_stk.empty() || i21_stk.back().depth != recur_cnt)
+        return;
+    prof_add(FDPP_PROF_INT21, i21_stk.back().ah, i21_stk.back().t0, 0);
+    i21_stk.pop_back();
+}
+
+/* a NORET exit unwound the current level: close its int21 frames */
+static void prof_int21_noret(void)
+{
+    while (!i21_stk.empty() && i21_stk.back().depth >= recur_cnt) {
+        prof_add(FDPP_PROF_INT21, i21_stk.back().ah, i21_stk.back().t0, 1);
+        i21_stk.pop_back();
+    }
+}
 
 enum { ASM_OK, ASM_NORET, ASM_ABORT, PING_ABORT };
 
@@ -157,9 +281,16 @@ void *resolve_segoff(struct far_s fa)
     return so2lin(fa.seg, fa.off);
 }
 
+static int do_ping(void)
+{
+    if (fdpp->ping_mode == FDPP_PING_ASYNC && !fdpp->ping_pending)
+        return 0;
+    return fdpp->ping();
+}
+
 void *resolve_segoff_fd(struct far_s fa)
 {
-    int ret = fdpp->ping();
+    int ret = do_ping();
     if (ret == -1) {
         fdlogprintf("access to %x:%x aborted\n", fa.seg, fa.off);
         fdpp_noret(PING_ABORT);
@@ -186,9 +317,10 @@ static int FdppSetAsmThunks(struct far_s *ptrs, int len)
     for (i = 0; i < len; i++) {
         *asm_thunks.arr[i] = ptrs[i];
         /* there are conflicts, for example InitTextStart will collide
-         * with the first sym. So use _replace. */
-        store_far_replace(&sym_tab, resolve_segoff(ptrs[i]), ptrs[i]);
+         * with the first sym. The later one wins on lookup. */
+        farhlp_add(&sym_tab, resolve_segoff(ptrs[i]), ptrs[i], i);
     }
+    farhlp_sort(&sym_tab);
 
     return 0;
 }
@@ -206,6 +338,44 @@ struct fdpp_symtab {
     struct far_s near_wrp[0];
 };
 
+static void update_asm_wrp(void)
+{
+    int i, j;
+
+    for (i = 0; i < asm_tab_len; i++) {
+        asm_wrp[i] = -1;
+        for (j = 0; j < num_wrps; j++) {
+            if (near_wrp[j].seg == asm_tab[i].seg) {
+                asm_wrp[i] = j;
+                break;
+            }
+        }
+    }
+}
+
+static void build_asm_idx(void)
+{
+    int i;
+
+    asm_idx_len = 0;
+    for (i = 0; i < asm_tab_len; i++) {
+        if (asm_tab[i].num >= asm_idx_len)
+            asm_idx_len = asm_tab[i].num + 1;
+    }
+    free(asm_idx);
+    asm_idx = (int *)malloc(sizeof(int) * asm_idx_len);
+    for (i = 0; i < asm_idx_len; i++)
+        asm_idx[i] = -1;
+    /* on duplicates, the first entry wins, as with the linear search */
+    for (i = asm_tab_len - 1; i >= 0; i--)
+        asm_idx[asm_tab[i].num] = i;
+    free(asm_cnt);
+    asm_cnt = (uint32_t *)calloc(asm_idx_len, sizeof(uint32_t));
+    free(asm_wrp);
+    asm_wrp = (int *)malloc(sizeof(int) * asm_tab_len);
+    update_asm_wrp();
+}
+
 static void do_relocs(UWORD old_seg, uint8_t *start_p, uint8_t *end_p,
         uint16_t delta)
 {
@@ -227,7 +397,7 @@ static void do_relocs(UWORD old_seg, uint8_t *start_p, uint8_t *end_p,
             reloc++;
         }
     }
-    fdlogprintf("processed %i relocs\n", reloc);
+    fdlog(FDPP_LOG_RELOC, "processed %i relocs\n", reloc);
     t = asm_tab;
     reloc = 0;
     for (i = 0; i < asm_tab_len; i++) {
@@ -242,7 +412,9 @@ static void do_relocs(UWORD old_seg, uint8_t *start_p, uint8_t *end_p,
             reloc++;
         }
     }
-    fdlogprintf("processed %i relocs\n", reloc);
+    fdlog(FDPP_LOG_RELOC, "processed %i relocs\n", reloc);
+    if (asm_wrp)
+        update_asm_wrp();
 }
 
 static void FdppSetSymTab(struct vm86_regs *regs, struct fdpp_symtab *symtab)
@@ -259,6 +431,8 @@ static void FdppSetSymTab(struct vm86_regs *regs, struct fdpp_symtab *symtab)
     asm_tab = (struct asm_dsc_s *)malloc(symtab->calltab_len);
     memcpy(asm_tab, resolve_segoff(symtab->calltab), symtab->calltab_len);
     asm_tab_len = symtab->calltab_len / sizeof(struct asm_dsc_s);
+    free(asm_wrp);
+    asm_wrp = NULL;
     /* now relocate init text */
     if (symtab->cur_cs > symtab->orig_cs) {
         int i;
@@ -266,7 +440,7 @@ static void FdppSetSymTab(struct vm86_regs *regs, struct fdpp_symtab *symtab)
         uint8_t *start_p = (uint8_t *)resolve_segoff(symtab->text_start);
         uint8_t *end_p = (uint8_t *)resolve_segoff(symtab->text_end);
         uint16_t delta = symtab->cur_cs - symtab->orig_cs;
-        fdlogprintf("init reloc %hx --> %hx, %tx\n", symtab->orig_cs,
+        fdlog(FDPP_LOG_RELOC, "init reloc %hx --> %hx, %tx\n", symtab->orig_cs,
                 symtab->cur_cs, end_p - start_p);
         do_relocs(symtab->orig_cs, start_p, end_p, delta);
         /* sym_tab table is patched in non-relocated code, never used later */
@@ -279,9 +453,10 @@ static void FdppSetSymTab(struct vm86_regs *regs, struct fdpp_symtab *symtab)
                 reloc++;
             }
         }
-        fdlogprintf("processed %i relocs\n", reloc);
+        fdlog(FDPP_LOG_RELOC, "processed %i relocs\n", reloc);
     }
 
+    build_asm_idx();
     err = FdppSetAsmThunks(thtab, stab_len);
     _assert(!err);
 }
@@ -301,11 +476,25 @@ static UDWORD FdppThunkCall(int fn, UBYTE *sp, int *r_len)
 
 #define _SP sp
 #define _DISP_CMN(f, c) { \
-    fdlogprintf("dispatch " #f "\n"); \
+    uint64_t _t0 = 0; \
+    fdlog(FDPP_LOG_DISPATCH, "dispatch " #f "\n"); \
+    if (trace_ring) \
+        trace_ev(fn, 0); \
+    if (prof_on) \
+        _t0 = now_ns(); \
     objtrace_enter(); \
     c; \
     objtrace_leave(); \
-    fdlogprintf("dispatch " #f " done, %i\n", recur_cnt); \
+    if (prof_on) { \
+        if (stat == DISP_NORET) \
+            prof_int21_noret(); \
+        /* 0 if profiling was turned on during the call */ \
+        if (_t0) \
+            prof_add(FDPP_PROF_IN, fn, _t0, stat == DISP_NORET); \
+    } \
+    if (trace_ring) \
+        trace_ev(fn, 1); \
+    fdlog(FDPP_LOG_DISPATCH, "dispatch " #f " done, %i\n", recur_cnt); \
 }
 #define _DISPATCH(r, f, ...) _DISP_CMN(f, { \
     ret = fdpp_dispatch(&stat, f, ##__VA_ARGS__); \
@@ -387,9 +576,18 @@ static int _FdppCall(struct vm86_regs *regs)
 int FdppCall(struct vm86_regs *regs)
 {
     int ret;
+    uint32_t cnt = ALLOC_CNT;
     recur_cnt++;
     ret = _FdppCall(regs);
     recur_cnt--;
+    /* nested calls are accounted to the outermost one */
+    if (!recur_cnt) {
+        uint32_t n = ALLOC_CNT - cnt;
+        heap_calls++;
+        heap_allocs += n;
+        if (n > heap_max)
+            heap_max = n;
+    }
     return ret;
 }
 
@@ -398,12 +596,89 @@ void do_abort(const char *file, int line)
     fdpp->abort(file, line);
 }
 
+uint32_t FdppAsmCallCount(int num)
+{
+    if (num < 0 || num >= asm_idx_len)
+        return 0;
+    return asm_cnt[num];
+}
+
+int FdppSecCacheDirty(void)
+{
+    return seccache_dirty_total();
+}
+
+void FdppHeapStats(uint32_t *calls, uint32_t *allocs, uint32_t *max)
+{
+    *calls = heap_calls;
+    *allocs = heap_allocs;
+    *max = heap_max;
+    heap_calls = heap_allocs = heap_max = 0;
+}
+
+void FdppProfEnable(int on)
+{
+    prof_on = on;
+    if (!on)
+        i21_stk.clear();
+}
+
+int FdppProfSnapshot(int kind, struct fdpp_prof_ent *buf, int max,
+        int reset)
+{
+    int i, len;
+
+    if (kind < 0 || kind >= FDPP_PROF_MAX)
+        return -1;
+    len = prof_tab[kind].size();
+    for (i = 0; i < len && i < max; i++)
+        buf[i] = prof_tab[kind][i];
+    if (reset)
+        prof_tab[kind].assign(len, {});
+    return len;
+}
+
+int FdppTraceSetup(unsigned entries)
+{
+    unsigned size = 1;
+
+    free(trace_ring);
+    trace_ring = NULL;
+    trace_size = trace_head = trace_tail = trace_lost = 0;
+    if (!entries)
+        return 0;
+    while (size < entries)
+        size <<= 1;
+    trace_ring = (struct fdpp_trace_ent *)malloc(size * sizeof(*trace_ring));
+    if (!trace_ring)
+        return -1;
+    trace_size = size;
+    return 0;
+}
+
+unsigned FdppTraceDrain(struct fdpp_trace_ent *buf, unsigned max,
+        uint32_t *lost)
+{
+    unsigned n = 0;
+
+    while (n < max && trace_tail != trace_head) {
+        buf[n++] = trace_ring[trace_tail & (trace_size - 1)];
+        trace_tail++;
+    }
+    if (lost) {
+        *lost = trace_lost;
+        trace_lost = 0;
+    }
+    return n;
+}
+
 int FdppInit(struct fdpp_api *api, int ver, int *req_ver)
 {
     *req_ver = FDPP_API_VER;
     if (ver != FDPP_API_VER)
         return -1;
     fdpp = api;
+    fdlog_mask = &api->log_mask;
     return 0;
 }
 
@@ -426,10 +701,23 @@ void fdprintf(const char *format, ...)
     va_end(vl);
 }
 
+/* callers with a category other than FDPP_LOG_MISC use fdlog() */
 void fdlogprintf(const char *format, ...)
 {
     va_list vl;
 
+    if (!(fdpp->log_mask & FDPP_LOG_MISC))
+        return;
+    va_start(vl, format);
+    fdlogvprintf(format, vl);
+    va_end(vl);
+}
+
+/* backend of fdlog(), which has already checked the category */
+void fdlogcprintf(const char *format, ...)
+{
+    va_list vl;
+
     va_start(vl, format);
     fdlogvprintf(format, vl);
     va_end(vl);
@@ -466,51 +754,39 @@ static void _call_wrp(FdppAsmCall_t call, struct vm86_regs *regs,
     call(regs, seg, off, sp, len);
 }
 
-static uint32_t _do_asm_call_far(int num, uint8_t *sp, uint8_t len,
-        FdppAsmCall_t call)
+static struct asm_dsc_s *find_asm(int num)
 {
-    int i;
+    int idx;
 
-    for (i = 0; i < asm_tab_len; i++) {
-        if (asm_tab[i].num == num) {
-            _call_wrp(call, &s_regs, asm_tab[i].seg, asm_tab[i].off, sp, len);
-            return (LO_WORD(s_regs.edx) << 16) | LO_WORD(s_regs.eax);
-        }
-    }
-    _assert(0);
-    return -1;
+    _assert(num >= 0 && num < asm_idx_len);
+    idx = asm_idx[num];
+    _assert(idx != -1);
+    asm_cnt[num]++;
+    return &asm_tab[idx];
 }
 
-static uint16_t find_wrp(uint16_t seg)
+static uint32_t _do_asm_call_far(int num, uint8_t *sp, uint8_t len,
+        FdppAsmCall_t call)
 {
-    int i;
+    struct asm_dsc_s *t = find_asm(num);
 
-    for (i = 0; i < num_wrps; i++) {
-        if (near_wrp[i].seg == seg)
-            return near_wrp[i].off;
-    }
-    _assert(0);
-    return -1;
+    _call_wrp(call, &s_regs, t->seg, t->off, sp, len);
+    return (LO_WORD(s_regs.edx) << 16) | LO_WORD(s_regs.eax);
 }
 
 static uint32_t _do_asm_call(int num, uint8_t *sp, uint8_t len,
         FdppAsmCall_t call)
 {
-    int i;
-
-    for (i = 0; i < asm_tab_len; i++) {
-        if (asm_tab[i].num == num) {
-            uint16_t wrp = find_wrp(asm_tab[i].seg);
-            LO_WORD(s_regs.eax) = asm_tab[i].off;
-            /* argpack should be aligned */
-            _assert(!(len & 1));
-            LO_WORD(s_regs.ecx) = len >> 1;
-            _call_wrp(call, &s_regs, asm_tab[i].seg, wrp, sp, len);
-            return (LO_WORD(s_regs.edx) << 16) | LO_WORD(s_regs.eax);
-        }
-    }
-    _assert(0);
-    return -1;
+    struct asm_dsc_s *t = find_asm(num);
+    int w = asm_wrp[t - asm_tab];
+
+    _assert(w != -1);
+    LO_WORD(s_regs.eax) = t->off;
+    /* argpack should be aligned */
+    _assert(!(len & 1));
+    LO_WORD(s_regs.ecx) = len >> 1;
+    _call_wrp(call, &s_regs, t->seg, near_wrp[w].off, sp, len);
+    return (LO_WORD(s_regs.edx) << 16) | LO_WORD(s_regs.eax);
 }
 
 static void asm_call(struct vm86_regs *regs, uint16_t seg,
@@ -521,7 +797,7 @@ static void asm_call(struct vm86_regs *regs, uint16_t seg,
     case ASM_CALL_OK:
         break;
     case ASM_CALL_ABORT:
-        fdlogprintf("reboot jump, %i\n", recur_cnt);
+        fdlog(FDPP_LOG_DISPATCH, "reboot jump, %i\n", recur_cnt);
         fdpp_noret(ASM_ABORT);
         break;
     }
@@ -532,18 +808,35 @@ static void asm_call_noret(struct vm86_regs *regs, uint16_t seg,
 {
     fdpp->asm_call_noret(regs, seg, off, sp, len);
     objtrace_mark();
-    fdlogprintf("noret jump, %i\n", recur_cnt);
+    fdlog(FDPP_LOG_DISPATCH, "noret jump, %i\n", recur_cnt);
     fdpp_noret(ASM_NORET);
 }
 
-static uint32_t do_asm_call(int num, uint8_t *sp, uint8_t len, int flags)
+static uint32_t _do_asm_call_any(int num, uint8_t *sp, uint8_t len,
+        int flags)
 {
-    uint32_t ret;
     FdppAsmCall_t call = ((flags & _TFLG_NORET) ? asm_call_noret : asm_call);
     if (flags & _TFLG_FAR)
-        ret = _do_asm_call_far(num, sp, len, call);
-    else
-        ret = _do_asm_call(num, sp, len, call);
+        return _do_asm_call_far(num, sp, len, call);
+    return _do_asm_call(num, sp, len, call);
+}
+
+static uint32_t do_asm_call(int num, uint8_t *sp, uint8_t len, int flags)
+{
+    uint32_t ret;
+    uint64_t t0;
+
+    if (!prof_on)
+        return _do_asm_call_any(num, sp, len, flags);
+    t0 = now_ns();
+    try {
+        ret = _do_asm_call_any(num, sp, len, flags);
+    }
+    catch (int) {
+        prof_add(FDPP_PROF_OUT, num, t0, 1);
+        throw;
+    }
+    prof_add(FDPP_PROF_OUT, num, t0, 0);
     return ret;
 }
 
@@ -717,59 +1010,69 @@ void fddebug(const BYTE * s, ...)
 
 void RelocHook(UWORD old_seg, UWORD new_seg, UWORD offs, UDWORD len)
 {
-    unsigned i;
-    int reloc = 0;
-    int miss = 0;
+    int i, first, reloc;
     uint8_t *start_p = (uint8_t *)so2lin(old_seg, offs);
     uint8_t *end_p = (uint8_t *)so2lin(old_seg + (len >> 4), (len & 0xf) + offs);
     uint16_t delta = new_seg - old_seg;
-    fdlogprintf("relocate %hx --> %hx, %x\n", old_seg, new_seg, len);
+    fdlog(FDPP_LOG_RELOC, "relocate %hx --> %hx, %x\n", old_seg, new_seg, len);
     do_relocs(old_seg, start_p, end_p, delta);
-    for (i = 0; i < _countof(asm_thunks.arr); i++) {
-        uint8_t *ptr = (uint8_t *)resolve_segoff(*asm_thunks.arr[i]);
-        if (ptr >= start_p && ptr <= end_p) {
-            int rm;
-            far_t f = lookup_far_unref(&sym_tab, ptr, &rm);
-            if (!f.seg && !f.off)
-                miss++;
-            else
-                _assert(rm);
-            if (old_seg == asm_thunks.arr[i]->seg)
-                asm_thunks.arr[i]->seg += delta;
-            store_far_replace(&sym_tab, resolve_segoff(*asm_thunks.arr[i]),
-                    *asm_thunks.arr[i]);
-            reloc++;
-        }
+    reloc = farhlp_range(&sym_tab, start_p, end_p, &first);
+    for (i = first; i < first + reloc; i++) {
+        struct f_m *fm = &sym_tab.tab[i];
+        far_s *th = asm_thunks.arr[fm->id];
+
+        if (old_seg == th->seg)
+            th->seg += delta;
+        fm->f = *th;
+        fm->ptr = resolve_segoff(*th);
     }
+    farhlp_rebase(&sym_tab, first, reloc);
     if (fdpp->relocate_notify)
         fdpp->relocate_notify(old_seg, new_seg, offs, len);
 
-    fdlogprintf("processed %i relocs (%i missed)\n", reloc, miss);
+    fdlog(FDPP_LOG_RELOC, "processed %i relocs\n", reloc);
 }
 
 void PurgeHook(void *ptr, UDWORD len)
 {
-    unsigned i;
-    int reloc = 0;
-    int miss = 0;
+    int i, first, reloc;
     uint8_t *start_p = (uint8_t *)ptr;
     uint8_t *end_p = start_p + len;
-    fdlogprintf("purge %p %x\n", ptr, len);
+    fdlog(FDPP_LOG_RELOC, "purge %p %x\n", ptr, len);
     do_relocs(0, start_p, end_p, 0);
-    for (i = 0; i < _countof(asm_thunks.arr); i++) {
-        uint8_t *ptr = (uint8_t *)resolve_segoff(*asm_thunks.arr[i]);
-        if (ptr >= start_p && ptr <= end_p) {
-            int rm;
-            far_t f = lookup_far_unref(&sym_tab, ptr, &rm);
-            if (!f.seg && !f.off)
-                miss++;
-            else
-                _assert(rm);
-            asm_thunks.arr[i]->seg = asm_thunks.arr[i]->off = 0;
-            reloc++;
-        }
+    reloc = farhlp_range(&sym_tab, start_p, end_p, &first);
+    for (i = first; i < first + reloc; i++) {
+        far_s *th = asm_thunks.arr[sym_tab.tab[i].id];
+        th->seg = th->off = 0;
     }
-    fdlogprintf("purged %i relocs (%i missed)\n", reloc, miss);
+    farhlp_erase(&sym_tab, first, reloc);
+    fdlog(FDPP_LOG_RELOC, "purged %i relocs\n", reloc);
+}
+
+/* should the console be polled for ^C/^S? */
+int fd_break_poll(void)
+{
+    if (fdpp->break_mode != FDPP_BREAK_NOTIFY)
+        return 1;
+    if (!fdpp->break_pending)
+        return 0;
+    /* cleared before the poll so that a new key is not lost */
+    fdpp->break_pending = 0;
+    return 1;
+}
+
+/* the poll found input that is still unread: keep polling */
+void fd_break_keep(void)
+{
+    if (fdpp->break_mode == FDPP_BREAK_NOTIFY)
+        fdpp->break_pending = 1;
+}
+
+int _fd_console_write(far_t ptr, UWORD len)
+{
+    if (!fdpp->console_write)
+        return -1;
+    return fdpp->console_write((const char *)resolve_segoff(ptr), len);
 }
 
 void _fd_mark_mem(far_t ptr, UWORD size, int type)
@@ -22,7 +22,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 
-#define FDPP_API_VER 25
+#define FDPP_API_VER 29
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +33,16 @@ int FdppCall(struct vm86_regs *regs);
 
 enum { FDPP_PRINT_LOG, FDPP_PRINT_TERMINAL, FDPP_PRINT_SCREEN };
 enum { ASM_CALL_OK, ASM_CALL_ABORT };
+enum { FDPP_PING_SYNC, FDPP_PING_ASYNC };
+enum { FDPP_BREAK_POLL, FDPP_BREAK_NOTIFY };
+/* log_mask categories */
+enum {
+    FDPP_LOG_MISC = 1,
+    FDPP_LOG_DISPATCH = 2,
+    FDPP_LOG_RELOC = 4,
+    FDPP_LOG_OBJ = 8,
+};
+#define FDPP_LOG_ALL 0xffffffffU
 
 struct fdpp_api {
     uint8_t *(*so2lin)(uint16_t seg, uint16_t off);
@@ -52,8 +62,69 @@ struct fdpp_api {
     void (*mark_mem)(uint16_t seg, uint16_t off, uint16_t size, int type);
     void (*prot_mem)(uint16_t seg, uint16_t off, uint16_t size, int type);
     int (*is_dos_space)(const void *ptr);
+    /* FDPP_PING_SYNC: ping() is called on every far pointer access.
+     * FDPP_PING_ASYNC: ping() is called only when the host has set
+     * ping_pending, for example from a signal handler. ping() is
+     * then responsible for clearing it. */
+    int ping_mode;
+    volatile int ping_pending;
+    /* FDPP_LOG_* categories to pass to print(FDPP_PRINT_LOG). The mask
+     * is checked before formatting, so disabled categories cost
+     * nothing. May be changed at any time. */
+    uint32_t log_mask;
+    /* Optional. Prints a run of characters on a FASTCON console in
+     * one call instead of one int 29h per character. Return 0 when
+     * done, or -1 to let the kernel use int 29h. Not called while a
+     * DOS program has hooked int 29h. */
+    int (*console_write)(const char *buf, uint16_t len);
+    /* FDPP_BREAK_POLL: the console driver is polled for ^C/^S on every
+     * check, that is per character of output and per int 21h call.
+     * FDPP_BREAK_NOTIFY: the driver is polled only after the host has
+     * set break_pending, which it must do on every keyboard input. */
+    int break_mode;
+    volatile int break_pending;
 };
 int FdppInit(struct fdpp_api *api, int ver, int *req_ver);
+uint32_t FdppAsmCallCount(int num);
+/* Number of sectors whose writes the write-back sector cache still
+ * delays. A host that stops the machine other than through int 19h
+ * should first run int 21h/0Dh in it while this is not 0. */
+int FdppSecCacheDirty(void);
+/* Host heap allocations done within FdppCall(): number of calls, total
+ * and per-call maximum since the previous query. Only counted when
+ * the library is built with -DFDPP_ALLOC_STATS, zeroes otherwise. */
+void FdppHeapStats(uint32_t *calls, uint32_t *allocs, uint32_t *max);
+
+/* Opt-in profiling, per thunk number in both directions and per
+ * INT 21h function (AH). Times are inclusive of nested calls. */
+enum { FDPP_PROF_IN, FDPP_PROF_OUT, FDPP_PROF_INT21, FDPP_PROF_MAX };
+struct fdpp_prof_ent {
+    uint32_t calls;
+    uint32_t noret;     /* left by a NORET or abort unwind */
+    uint64_t total_ns;
+    uint64_t max_ns;
+};
+void FdppProfEnable(int on);
+/* Copy up to "max" counters of the given FDPP_PROF_* table to buf,
+ * index is the thunk number or AH. Returns the table size, which can
+ * exceed max, or -1. With "reset" set, the counters are zeroed. */
+int FdppProfSnapshot(int kind, struct fdpp_prof_ent *buf, int max,
+        int reset);
+
+/* Binary trace of kernel entries: one record on entry and one on exit
+ * of each dispatched function. */
+struct fdpp_trace_ent {
+    uint64_t ts;        /* CLOCK_MONOTONIC, ns */
+    uint16_t fn;        /* thunk number */
+    uint8_t depth;      /* FdppCall() recursion depth */
+    uint8_t leave;
+};
+/* Allocate a ring of at least "entries" records, 0 disables tracing. */
+int FdppTraceSetup(unsigned entries);
+/* Move up to "max" oldest records to buf, return the number moved.
+ * Records that did not fit in a full ring are counted in *lost. */
+unsigned FdppTraceDrain(struct fdpp_trace_ent *buf, unsigned max,
+        uint32_t *lost);
 
 const char *FdppDataDir(void);
 const char *FdppKernelName(void);
@@ -33,7 +33,16 @@ void thunk_call_void_noret(struct far_s fa);
 struct far_s lookup_far_st(const void *ptr);
 void fdprintf(const char *format, ...) PRINTF(1);
 void fdlogprintf(const char *format, ...) PRINTF(1);
+void fdlogcprintf(const char *format, ...) PRINTF(1);
 void fdloudprintf(const char *format, ...) PRINTF(1);
+void fdprof_int21_enter(uint8_t ah);
+void fdprof_int21_leave(void);
+extern const uint32_t *fdlog_mask;
+/* log only if the host enabled category c, before any formatting */
+#define fdlog(c, ...) do { \
+    if (*fdlog_mask & (c)) \
+        fdlogcprintf(__VA_ARGS__); \
+} while (0)
 void fdvprintf(const char *format, va_list vl);
 void fddebug(const BYTE * s, ...);
 int is_dos_space(const void *ptr);
@@ -197,6 +197,10 @@ void _fd_prot_mem(far_t ptr, UWORD size, int type);
 #define fd_prot_mem(p, s, t) _fd_prot_mem(GET_FAR(p), s, t)
 void _fd_mark_mem_np(far_t ptr, UWORD size, int type);
 #define fd_mark_mem_np(p, s, t) _fd_mark_mem_np(GET_FAR(p), s, t)
+int _fd_console_write(far_t ptr, UWORD len);
+int fd_break_poll(void);
+void fd_break_keep(void);
+#define fd_console_write(p, l) _fd_console_write(GET_FAR(p), l)
 
 #ifdef __cplusplus
 #include "farptr.hpp"
@@ -30,12 +30,22 @@
 
 #include "portab.h"
 #include "globals.h"
+#include "bufidx.h"
+#include "seccache.h"
+#include "extcache.h"
+#include "fatmap.h"
+#include "execache.h"
+#include "dirindex.h"
 
 #ifdef VERSION_STRINGS
 static BYTE *blockioRcsId =
     "$Id: blockio.c 1702 2012-02-04 08:46:16Z perditionc $";
 #endif
 
+/* multi-sector transfer buffer, set up by READAHEAD=           */
+BSS(UBYTE FAR *, XferBuffer, NULL);
+BSS(UWORD, XferBufSecs, 0);
+
 #define b_next(bp) ((struct buffer FAR *)(MK_FP(FP_SEG(bp), bp->b_next)))
 #define b_prev(bp) ((struct buffer FAR *)(MK_FP(FP_SEG(bp), bp->b_prev)))
 #define bufptr(fbp) ((struct buffer FAR *)(MK_FP(FP_SEG(bp), fbp)))
@@ -48,6 +58,9 @@ static BYTE *blockioRcsId =
 /* #define DISPLAY_GETBLOCK */
 
 STATIC BOOL flush1(struct buffer FAR * bp);
+STATIC BOOL flush_runs(COUNT dsk);
+STATIC UWORD dskxfer_dev(COUNT dsk, ULONG blkno, VOID FAR * buf,
+                         UWORD numblocks, COUNT mode);
 
 /*
     this searches the buffer list for the given disk/block.
@@ -78,6 +91,27 @@ STATIC void move_buffer(struct buffer FAR *bp, UWORD firstbp)
   b_prev(bp)->b_next = FP_OFF(bp);
 }
 
+STATIC BOOL holdsblock(struct buffer FAR *bp, ULONG blkno, COUNT dsk)
+{
+  return (bp->b_blkno == blkno) &&
+      (bp->b_flag & BFR_VALID) && (bp->b_unit == dsk);
+}
+
+STATIC struct buffer FAR *hitblock(struct buffer FAR *bp, UWORD firstbp)
+{
+  /* found it -- rearrange LRU links      */
+#ifdef DISPLAY_GETBLOCK
+  _printf("HIT %04x:%04x]\n", FP_SEG(bp), FP_OFF(bp));
+#endif
+  bp->b_flag &= ~BFR_UNCACHE;  /* reset uncache attribute */
+  if (FP_OFF(bp) != firstbp)
+  {
+    *(UWORD *)&firstbuf = FP_OFF(bp);
+    move_buffer(bp, firstbp);
+  }
+  return bp;
+}
+
 STATIC struct buffer FAR *searchblock(ULONG blkno, COUNT dsk)
 {
   int fat_count = 0;
@@ -86,31 +120,33 @@ STATIC struct buffer FAR *searchblock(ULONG blkno, COUNT dsk)
   UWORD uncacheBuf = 0;
   seg bufseg = FP_SEG(firstbuf);
   UWORD firstbp = FP_OFF(firstbuf);
+  int idx;
 
 #ifdef DISPLAY_GETBLOCK
   _printf("[searchblock %d, blk %ld, buf ", dsk, blkno);
 #endif
 
+  /* Look up the block in the index first. It is only a hint, */
+  /* so check that the buffer still holds the block.          */
+  idx = bufidx_find(dsk, blkno);
+  if (idx != -1)
+  {
+    bp = MK_FP(bufseg, idx);
+    if (holdsblock(bp, blkno, dsk))
+      return hitblock(bp, firstbp);
+    bufidx_del(dsk, blkno, idx);
+  }
+
   /* Search through buffers to see if the required block  */
   /* is already in a buffer                               */
 
   bp = MK_FP(bufseg, firstbp);
   do
   {
-    if ((bp->b_blkno == blkno) &&
-        (bp->b_flag & BFR_VALID) && (bp->b_unit == dsk))
+    if (holdsblock(bp, blkno, dsk))
     {
-      /* found it -- rearrange LRU links      */
-#ifdef DISPLAY_GETBLOCK
-      _printf("HIT %04x:%04x]\n", FP_SEG(bp), FP_OFF(bp));
-#endif
-      bp->b_flag &= ~BFR_UNCACHE;  /* reset uncache attribute */
-      if (FP_OFF(bp) != firstbp)
-      {
-        *(UWORD *)&firstbuf = FP_OFF(bp);
-        move_buffer(bp, firstbp);
-      }
-      return bp;
+      bufidx_add(dsk, blkno, FP_OFF(bp));
+      return hitblock(bp, firstbp);
     }
 
     if (bp->b_flag & BFR_UNCACHE)
@@ -157,25 +193,28 @@ STATIC struct buffer FAR *searchblock(ULONG blkno, COUNT dsk)
 
 BOOL DeleteBlockInBufferCache(ULONG blknolow, ULONG blknohigh, COUNT dsk, int mode)
 {
-  struct buffer FAR *bp = firstbuf;
+  struct buffer FAR *bp;
+  ULONG blkno = blknolow;
+  int idx;
 
-  /* Search through buffers to see if the required block  */
-  /* is already in a buffer                               */
+  /* Look up the indexed buffers that hold blocks in range */
 
-  do
+  while ((idx = bufidx_next(dsk, &blkno, blknohigh)) != -1)
   {
-    if (blknolow <= bp->b_blkno &&
-        bp->b_blkno <= blknohigh &&
-        (bp->b_flag & BFR_VALID) && (bp->b_unit == dsk))
+    bp = MK_FP(FP_SEG(firstbuf), idx);
+    if (holdsblock(bp, blkno, dsk))
     {
       if (mode == XFR_READ)
         flush1(bp);
       else
         bp->b_flag = 0;
     }
-    bp = b_next(bp);
+    if (!holdsblock(bp, blkno, dsk))
+      bufidx_del(dsk, blkno, idx);
+    if (blkno == blknohigh)
+      break;
+    blkno++;
   }
-  while (FP_OFF(bp) != FP_OFF(firstbuf));
 
   return FALSE;
 }
@@ -228,17 +267,21 @@ struct buffer FAR *getblk(ULONG blkno, COUNT dsk, BOOL overwrite)
   /* take the buffer that lbp points to and flush it, then read new block. */
   if (!flush1(bp))
     return NULL;
+  bufidx_del(bp->b_unit, bp->b_blkno, FP_OFF(bp));
 
   /* Fill the indicated disk buffer with the current track and sector */
 
   if (!overwrite && dskxfer(dsk, blkno, bp->b_buffer, 1, DSKREAD))
   {
+    /* it is out of the index now, so it must not stay valid */
+    bp->b_flag = 0;
     return NULL;
   }
 
   bp->b_flag = BFR_VALID | BFR_DATA;
   bp->b_unit = dsk;
   bp->b_blkno = blkno;
+  bufidx_add(dsk, blkno, FP_OFF(bp));
 
   return bp;
 }
@@ -257,6 +300,22 @@ VOID setinvld(REG COUNT dsk)
     bp = b_next(bp);
   }
   while (FP_OFF(bp) != FP_OFF(firstbuf));
+  bufidx_del_unit(dsk);
+  inval_host_caches(dsk);
+}
+
+/*                                                                      */
+/*      Drop the host-side caches of a disk whose sectors may have      */
+/*      been changed behind them                                        */
+/*                                                                      */
+VOID inval_host_caches(REG COUNT dsk)
+{
+  extcache_del_unit(dsk);
+  fatmap_del_unit(dsk);
+  execache_inval_unit(dsk);
+  dirindex_del_unit(dsk);
+  flush_seccache(dsk);
+  seccache_inval(dsk);
 }
 
 /*      Check if there is at least one dirty buffer                     */
@@ -273,7 +332,7 @@ BOOL dirty_buffers(REG COUNT dsk)
     bp = b_next(bp);
   }
   while (FP_OFF(bp) != FP_OFF(firstbuf));
-  return FALSE;
+  return seccache_dirty(dsk) != 0;
 }
 
 /*                                                                      */
@@ -286,7 +345,7 @@ BOOL dirty_buffers(REG COUNT dsk)
 BOOL flush_buffers(REG COUNT dsk)
 {
   struct buffer FAR *bp = firstbuf;
-  REG BOOL ok = TRUE;
+  REG BOOL ok = flush_runs(dsk);
 
   bp = firstbuf;
   do
@@ -297,9 +356,37 @@ BOOL flush_buffers(REG COUNT dsk)
     bp = b_next(bp);
   }
   while (FP_OFF(bp) != FP_OFF(firstbuf));
+  if (!flush_seccache(dsk))
+    ok = FALSE;
   return ok;
 }
 
+/*                                                                      */
+/*      Number of copies of a buffer to write and the distance of them  */
+/*                                                                      */
+STATIC UBYTE buf_copies(struct buffer FAR * bp, ULONG * b_offset)
+{
+  *b_offset = 0;
+  if (!(bp->b_flag & BFR_FAT))
+    return 1;
+  *b_offset = bp->b_offset;
+#ifdef WITHFAT32
+  if (*b_offset == 0) /* FAT32 FS */
+    *b_offset = bp->b_dpbp->dpb_xfatsize;
+#endif
+  return bp->b_copies;
+}
+
+STATIC VOID flush_done(struct buffer FAR * bp, BOOL ok)
+{
+  bp->b_flag &= ~BFR_DIRTY;     /* even if error, mark not dirty */
+  if (!ok)                      /* otherwise system has trouble  */
+  {
+    bp->b_flag &= ~BFR_VALID;   /* continuing.           */
+    bufidx_del(bp->b_unit, bp->b_blkno, FP_OFF(bp));
+  }
+}
+
 /*                                                                      */
 /*      Write one disk buffer                                           */
 /*                                                                      */
@@ -309,22 +396,10 @@ STATIC BOOL flush1(struct buffer FAR * bp)
 
   if ((bp->b_flag & (BFR_VALID | BFR_DIRTY)) == (BFR_VALID | BFR_DIRTY))
   {
-#ifdef WITHFAT32
-    ULONG b_offset = 0;
-#else
-    UWORD b_offset = 0;
-#endif
-    UBYTE b_copies = 1;
+    ULONG b_offset;
+    UBYTE b_copies = buf_copies(bp, &b_offset);
     ULONG blkno = bp->b_blkno;
-    if (bp->b_flag & BFR_FAT)
-    {
-      b_copies = bp->b_copies;
-      b_offset = bp->b_offset;
-#ifdef WITHFAT32
-      if (b_offset == 0) /* FAT32 FS */
-        b_offset = bp->b_dpbp->dpb_xfatsize;
-#endif
-    }
+
     while (b_copies--)
     {
       if (dskxfer(bp->b_unit, blkno, bp->b_buffer, 1, DSKWRITE))
@@ -332,9 +407,92 @@ STATIC BOOL flush1(struct buffer FAR * bp)
       blkno += b_offset;
     }
   }
-  bp->b_flag &= ~BFR_DIRTY;     /* even if error, mark not dirty */
-  if (!ok)                      /* otherwise system has trouble  */
-    bp->b_flag &= ~BFR_VALID;   /* continuing.           */
+  flush_done(bp, ok);
+  return ok;
+}
+
+/* the dirty buffer holding blkno, if it can join a run that    */
+/* is written like first                                        */
+STATIC struct buffer FAR *run_next(struct buffer FAR * first,
+                                   ULONG blkno, COUNT dsk)
+{
+  struct buffer FAR *bp;
+  ULONG off, first_off;
+  int idx = bufidx_find(dsk, blkno);
+
+  if (idx == -1)
+    return NULL;
+  bp = MK_FP(FP_SEG(firstbuf), idx);
+  if (!holdsblock(bp, blkno, dsk) || !(bp->b_flag & BFR_DIRTY) ||
+      (bp->b_flag & BFR_FAT) != (first->b_flag & BFR_FAT) ||
+      buf_copies(bp, &off) != buf_copies(first, &first_off) ||
+      off != first_off)
+    return NULL;
+  return bp;
+}
+
+/*                                                                      */
+/*      Write the dirty buffers of a disk in the order of their blocks, */
+/*      merging adjacent ones into one transfer through XferBuffer.     */
+/*      Buffers that are not indexed are left for flush1().             */
+/*                                                                      */
+STATIC BOOL flush_runs(COUNT dsk)
+{
+  struct buffer FAR *bp;
+  struct dpb FAR *dpbp;
+  ULONG blkno = 0, b_offset, wblk;
+  UWORD secsize, n, i;
+  UBYTE b_copies;
+  BOOL ok = TRUE, wok;
+  int idx;
+
+  /* XferBuffer is not allocated before PostConfig() */
+  if (XferBuffer == NULL || XferBufSecs < 2 ||
+      (dpbp = get_dpb(dsk)) == NULL)
+    return TRUE;
+  secsize = dpbp->dpb_secsize;
+
+  while ((idx = bufidx_next(dsk, &blkno, 0xffffffffUL)) != -1)
+  {
+    bp = MK_FP(FP_SEG(firstbuf), idx);
+    if (!holdsblock(bp, blkno, dsk) || !(bp->b_flag & BFR_DIRTY) ||
+        run_next(bp, blkno + 1, dsk) == NULL)
+    {
+      /* nothing to merge with */
+      if (holdsblock(bp, blkno, dsk) && !flush1(bp))
+        ok = FALSE;
+      if (blkno == 0xffffffffUL)
+        break;
+      blkno++;
+      continue;
+    }
+
+    /* collect the run */
+    b_copies = buf_copies(bp, &b_offset);
+    fmemcpy(XferBuffer, bp->b_buffer, secsize);
+    for (n = 1; n < XferBufSecs; n++)
+    {
+      struct buffer FAR *nbp = run_next(bp, blkno + n, dsk);
+      if (nbp == NULL)
+        break;
+      fmemcpy(XferBuffer + n * secsize, nbp->b_buffer, secsize);
+    }
+
+    /* write it to every copy of the FAT, or once for data */
+    wok = TRUE;
+    for (wblk = blkno; b_copies--; wblk += b_offset)
+      if (dskxfer(dsk, wblk, XferBuffer, n, DSKWRITE))
+        wok = FALSE;
+
+    for (i = 0; i < n; i++)
+    {
+      idx = bufidx_find(dsk, blkno + i);
+      flush_done(MK_FP(FP_SEG(firstbuf), idx), wok);
+    }
+    if (!wok)
+      ok = FALSE;
+    blkno += n;
+  }
   return ok;
 }
 
@@ -345,8 +503,12 @@ BOOL flush(void)
 {
   REG struct buffer FAR *bp = firstbuf;
   REG BOOL ok;
+  COUNT dsk;
 
   ok = TRUE;
+  for (dsk = 0; dsk < lastdrive; dsk++)
+    if (!flush_runs(dsk))
+      ok = FALSE;
   do
   {
     if (!flush1(bp))
@@ -355,6 +517,12 @@ BOOL flush(void)
     bp = b_next(bp);
   }
   while (FP_OFF(bp) != FP_OFF(firstbuf));
+  bufidx_reset();
+  for (dsk = 0; dsk < lastdrive; dsk++)
+    if (!flush_seccache(dsk))
+      ok = FALSE;
+  /* failed sectors were dropped, nothing is delayed any more */
+  seccache_wb_pending = 0;
 
   network_redirector(REM_FLUSHALL);
 
@@ -367,11 +535,104 @@ BOOL flush(void)
 /*                                                                      */
 /************************************************************************/
 /*                                                                      */
-/* Transfer one or more blocks to/from disk                             */
+/*      Write out the sectors delayed by the host sector cache          */
+/*                                                                      */
+/*      returns:                                                        */
+/*              TRUE on success                                         */
+/*                                                                      */
+BOOL flush_seccache(COUNT dsk)
+{
+  struct dpb FAR *dpbp;
+  ULONG blkno;
+  BOOL ok = TRUE;
+  VOID FAR *buf = deblock_buf;
+  UWORD max = 1, n;
+
+  if (!seccache_dirty(dsk))
+    return TRUE;
+  dpbp = get_dpb(dsk);
+  if (dpbp == NULL)
+  {
+    seccache_inval(dsk);
+    return FALSE;
+  }
+  if (XferBuffer != NULL && XferBufSecs >= 2)
+  {
+    buf = XferBuffer;
+    max = XferBufSecs;
+  }
+  while ((n = seccache_next_dirty(dsk, &blkno, buf, max,
+                                  dpbp->dpb_secsize)) != 0)
+  {
+    if (dskxfer_dev(dsk, blkno, buf, n, DSKWRITE))
+    {
+      ok = FALSE;
+      seccache_drop(dsk, blkno, n);
+    }
+    else
+      seccache_clean(dsk, blkno, n);
+  }
+  return ok;
+}
+
+/*                                                                      */
+/* Transfer one or more blocks to/from disk, through the host sector    */
+/* cache if it was enabled with SECCACHE=                               */
 /*                                                                      */
 
 UWORD dskxfer(COUNT dsk, ULONG blkno, VOID FAR * buf, UWORD numblocks,
               COUNT mode)
+{
+  REG struct dpb FAR *dpbp;
+  UWORD secsize;
+  UWORD ret;
+
+  if (!seccache_enabled())
+    return dskxfer_dev(dsk, blkno, buf, numblocks, mode);
+  dpbp = get_dpb(dsk);
+  if (dpbp == NULL)
+  {
+    return 0x0201;              /* illegal command */
+  }
+  secsize = dpbp->dpb_secsize;
+
+  switch (mode)
+  {
+    case DSKREAD:
+    case DSKREADINT25:
+      if (seccache_read(dsk, blkno, buf, numblocks, secsize))
+        return 0;
+      ret = dskxfer_dev(dsk, blkno, buf, numblocks, mode);
+      if (ret == 0)
+        seccache_fill(dsk, blkno, buf, numblocks, secsize);
+      return ret;
+
+    case DSKWRITE:
+      /* delay writes only for fixed disks */
+      if (dpbp->dpb_mdb == 0xf8 &&
+          seccache_write(dsk, blkno, buf, numblocks, secsize))
+      {
+        seccache_wb_pending = 1;
+        return 0;
+      }
+      /* else fall through */
+    case DSKWRITEINT26:
+      ret = dskxfer_dev(dsk, blkno, buf, numblocks, mode);
+      if (ret == 0)
+        seccache_store(dsk, blkno, buf, numblocks, secsize);
+      else
+        seccache_drop(dsk, blkno, numblocks);
+      return ret;
+  }
+  return dskxfer_dev(dsk, blkno, buf, numblocks, mode);
+}
+
+/*                                                                      */
+/* Transfer one or more blocks to/from the device                       */
+/*                                                                      */
+
+STATIC UWORD dskxfer_dev(COUNT dsk, ULONG blkno, VOID FAR * buf,
+                         UWORD numblocks, COUNT mode)
 {
   REG struct dpb FAR *dpbp = get_dpb(dsk);
   if (dpbp == NULL)
@@ -503,6 +764,7 @@ void AllocateHMASpace (size_t lowbuffer, size_t highbuffer)
     if (FP_OFF(bp) < highbuffer && FP_OFF(bp+1) > lowbuffer)
     {
       flush1(bp);
+      bufidx_del(bp->b_unit, bp->b_blkno, FP_OFF(bp));
       /* unlink bp from buffer chain */
 
       b_prev(bp)->b_next = bp->b_next;
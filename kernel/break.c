@@ -51,11 +51,25 @@ unsigned char ctrl_break_pressed(void)
   return CB_FLG & CB_MSK;
 }
 
+/* The syscon poll is a full driver request. Unless the host asks
+ * for it to be done always, it is only done after a keyboard event. */
+STATIC int poll_syscon(void)
+{
+  int c;
+
+  if (!fd_break_poll())
+    return -1;
+  c = ndread(&syscon);
+  if (c != -1)
+    fd_break_keep();
+  return c;
+}
+
 unsigned char check_handle_break(__DOSFAR(struct dhdr) *pdev)
 {
   unsigned char c = CTL_C;
   if (!ctrl_break_pressed())
-    c = (unsigned char)ndread(&syscon);
+    c = (unsigned char)poll_syscon();
   if (c != CTL_C && *pdev != syscon)
     c = (unsigned char)ndread(pdev);
   if (c == CTL_C)
@@ -179,48 +179,127 @@ void update_scr_pos(unsigned char c, unsigned char count)
   scr_pos = scrpos;
 }
 
+/* update_scr_pos(c, 1) for a whole block: only what follows the last
+   CR matters, so scan back to it in host memory and count forward
+   from there, instead of a far access per character */
+void update_scr_pos_blk(const char FAR *bp, size_t n)
+{
+  const unsigned char *p = (const unsigned char *)GET_PTR(bp);
+  unsigned char scrpos = scr_pos;
+  size_t i = n;
+
+  while (i > 0 && p[i - 1] != CR)
+    i--;
+  if (i > 0)
+    scrpos = 0;
+  for (; i < n; i++)
+  {
+    unsigned char c = p[i];
+    if (c == BS) {
+      if (scrpos > 0)
+        scrpos--;
+    } else if (c != LF && c != BELL) {
+      scrpos++;
+    }
+  }
+  scr_pos = scrpos;
+}
+
 STATIC int raw_get_char(__DOSFAR(struct dhdr) *pdev, BOOL check_break);
 
-long cooked_write(__DOSFAR(struct dhdr) *pdev, size_t n, __XFAR(const char)bp)
+/* the host console bypasses int 29h: use it only while no driver */
+/* such as ANSI.SYS has hooked that vector                        */
+STATIC BOOL int29_is_ours(void)
 {
-  size_t xfer;
+  intvec v = getvec(0x29);
 
-  /* bit 7 means fastcon; low 5 bits count number of characters */
-  unsigned char fast_counter = ((*pdev)->dh_attr & ATTR_FASTCON) << 3;
+  return FP_SEG(v) == FP_SEG(int29_handler) &&
+         FP_OFF(v) == FP_OFF(int29_handler);
+}
+
+/* longest run written at once, bounds the ^C/^S latency */
+#define COOKED_RUN 128
 
-  for (xfer = 0; xfer < n; xfer++)
+/* write a run of characters that need no cooking */
+STATIC int put_run(__DOSFAR(struct dhdr) *pdev, BOOL fast, size_t len,
+                   __XFAR(const char)bp)
+{
+  long err;
+  void FAR *run = (void FAR *)bp;
+
+  if (PrinterEcho)
+    DosWrite(STDPRN, len, run);
+  if (fast)
+  {
+    /* the host may take the whole run, else int 29h per character */
+    if (!int29_is_ours() || fd_console_write(bp, len) != 0)
+    {
+      size_t i;
+      for (i = 0; i < len; i++)
+        fast_put_char(bp[i]);
+    }
+    return SUCCESS;
+  }
+  err = BinaryCharIO(pdev, len, run, C_OUTPUT);
+  return err < 0 ? (int)err : SUCCESS;
+}
+
+/* Write in cooked mode; maybe with printer echo; handles TAB
+   expansion. Everything up to the next TAB or ^Z goes out at once:
+   as one C_OUTPUT request, or for FASTCON devices through the host
+   console or int 29h. Break and ^S are checked once per run. */
+long cooked_write(__DOSFAR(struct dhdr) *pdev, size_t n, __XFAR(const char)bp)
+{
+  size_t xfer = 0;
+  BOOL fast = ((*pdev)->dh_attr & ATTR_FASTCON) != 0;
+
+  while (xfer < n)
   {
     int err;
-    unsigned char count = 1, c = *bp++;
+    size_t len;
 
-    if (c == CTL_Z)
-      break;
+    for (len = 0; xfer + len < n && len < COOKED_RUN; len++)
+    {
+      unsigned char c = bp[len];
+      if (c == HT || c == CTL_Z)
+        break;
+    }
 
-    /* write a character in cooked mode; maybe with printer echo;
-       handles TAB expansion */
-    if (c == HT) {
+    if (check_handle_break(pdev) == CTL_S)
+      raw_get_char(pdev, TRUE); /* Test for hold char and ctl_c */
+
+    if (len == 0)
+    {
+      unsigned char count, c = ' ';
+
+      if (*bp == CTL_Z)
+        break;
+      /* TAB expansion */
       count = 8 - (scr_pos & 7);
-      c = ' ';
+      update_scr_pos(c, count);
+      do {
+        if (PrinterEcho)
+          DosWrite(STDPRN, 1, MK_FAR_SCP(c));
+        if (fast)
+          fast_put_char(c);
+        else
+        {
+          err = CharIO(pdev, c, C_OUTPUT);
+          if (err < 0)
+            return err;
+        }
+      } while (--count != 0);
+      bp++;
+      xfer++;
+      continue;
     }
-    update_scr_pos(c, count);
-    do {
-      /* if not fast then < 0x80; always check
-         otherwise check every 32 characters */
-      if (fast_counter <= 0x80 && check_handle_break(pdev) == CTL_S)
-        raw_get_char(pdev, TRUE); /* Test for hold char and ctl_c */
-      fast_counter++;
-      fast_counter &= 0x9f;
-      if (PrinterEcho)
-        DosWrite(STDPRN, 1, MK_FAR_SCP(c));
-      if (fast_counter & 0x80)
-        fast_put_char(c);
-      else
-      {
-        err = CharIO(pdev, c, C_OUTPUT);
-        if (err < 0)
-          return err;
-      }
-    } while (--count != 0);
+
+    update_scr_pos_blk(bp, len);
+    err = put_run(pdev, fast, len, bp);
+    if (err < 0)
+      return err;
+    bp += len;
+    xfer += len;
   }
   return xfer;
 }
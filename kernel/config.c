@@ -32,6 +32,9 @@
 #include "init-mod.h"
 #include "dyndata.h"
 #include "debug.h"
+#include "bufidx.h"
+#include "seccache.h"
+#include "execache.h"
 
 #ifdef VERSION_STRINGS
 static const char *RcsId =
@@ -242,6 +245,9 @@ STATIC VOID StacksHigh(char * pLine);
 
 STATIC VOID SetAnyDos(char * pLine);
 STATIC VOID SetIdleHalt(char * pLine);
+STATIC VOID CfgSecCache(char * pLine);
+STATIC VOID CfgReadAhead(char * pLine);
+STATIC VOID CfgExeCache(char * pLine);
 STATIC VOID Numlock(char * pLine);
 STATIC char *GetNumArg(char * pLine, COUNT * pnArg);
 char *GetStringArg(char * pLine, char * pszString);
@@ -307,6 +313,9 @@ DATAAIS(struct table, commands, {
   {"VERSION", 1, sysVersion},     /* JPP */
   {"ANYDOS", 1, SetAnyDos},       /* tom */
   {"IDLEHALT", 1, SetIdleHalt},   /* ea  */
+  {"SECCACHE", 1, CfgSecCache},   /* fdpp */
+  {"READAHEAD", 1, CfgReadAhead}, /* fdpp */
+  {"EXECACHE", 1, CfgExeCache},   /* fdpp */
   {"CHAIN", 1, CmdChain},
 
   {"DEVICE", 2, Device},
@@ -497,9 +506,12 @@ void PostConfig(void)
     DebugPrintf(("Stacks allocated at %P\n", GET_FP32(stackBase)));
   }
 #ifdef FDPP
-#define DOSOBJ_POOL2 256
+#define DOSOBJ_POOL2 DOSOBJ_POOL_SIZE(256)
   dosobj = KernelAlloc(DOSOBJ_POOL2, 'B', Config.cfgDosDataUmb);
 #endif
+  if (XferBufSecs)
+    XferBuffer = KernelAlloc(XferBufSecs * MAX_SEC_SIZE, 'B',
+                                  Config.cfgDosDataUmb);
   DebugPrintf(("Allocation completed: top at 0x%x\n", base_seg));
 }
 
@@ -2380,6 +2392,7 @@ STATIC void config_init_buffers(int wantedbuffers)
   }
   LoL->_deblock_buf = DiskTransferBuffer;
   LoL->_firstbuf = pbuffer;
+  bufidx_reset();
 
   DebugPrintf(("init_buffers (size %zu) at", sizeof(struct buffer)));
   DebugPrintf((" (%P)", GET_FP32(LoL->_firstbuf)));
@@ -2437,6 +2450,72 @@ STATIC VOID SetIdleHalt(char * pLine)
     HaltCpuWhileIdle = haltlevel; /* 0 for no HLT, 1..n more, -1 max */
 }
 
+/*
+   fdpp: host-side sector cache below the block device layer.
+   SECCACHE=megabytes[,writeback]
+   size is per drive, 0 disables the cache. writeback=1 delays
+   writes to fixed disks until flush or commit, 0 writes through.
+*/
+STATIC VOID CfgSecCache(char * pLine)
+{
+  COUNT mbytes;
+  COUNT wback = 0;
+
+  if ((pLine = GetNumArg(pLine, &mbytes)) == 0)
+    return;
+  pLine = skipwh(pLine);
+  if (*pLine == ',')
+    GetNumArg(++pLine, &wback);
+  if (mbytes < 0)
+    mbytes = 0;
+  /* write out what an earlier SECCACHE= line delayed */
+  if (seccache_wb_pending)
+  {
+    iregs r = {};
+
+    r.a.b.h = 0x0d;
+    init_call_intr(0x21, &r);
+  }
+  seccache_setup(mbytes, wback);
+}
+
+/*
+   fdpp: multi-sector transfer buffer.
+   READAHEAD=sectors
+   maximum number of sectors prefetched with one transfer for
+   sequential file reads (needs SECCACHE), and merged into one
+   transfer when flushing dirty buffers. 0 disables.
+*/
+STATIC VOID CfgReadAhead(char * pLine)
+{
+  COUNT secs;
+
+  if (GetNumArg(pLine, &secs) == 0)
+    return;
+  if (secs < 2)
+    secs = 0;
+  if (secs > 64)
+    secs = 64;
+  XferBufSecs = secs;
+}
+
+/*
+   fdpp: host-side cache of executable images.
+   EXECACHE=kilobytes
+   programs loaded with EXEC are kept in host memory, so that the
+   next load of the same file does not read it again. 0 disables.
+*/
+STATIC VOID CfgExeCache(char * pLine)
+{
+  COUNT kbytes;
+
+  if (GetNumArg(pLine, &kbytes) == 0)
+    return;
+  if (kbytes < 0)
+    kbytes = 0;
+  execache_setup(kbytes);
+}
+
 STATIC VOID CfgIgnore(char * pLine)
 {
   UNREFERENCED_PARAMETER(pLine);
@@ -34,6 +34,8 @@ static BYTE *dosfnsRcsId =
 #endif
 
 #include "globals.h"
+#include "extcache.h"
+#include "readahead.h"
 
 /* /// Added for SHARE.  - Ron Cemer */
 
@@ -207,10 +209,8 @@ long DosRWSft(int sft_idx, size_t n, __XFAR(void)bp, int mode)
                              mode == XFR_READ ? C_INPUT : C_OUTPUT);
       if (mode == XFR_WRITE && rc > 0 && (s->sft_flags & SFT_FCONOUT))
       {
-        size_t cnt = (size_t)rc;
         const char FAR *p = bp;
-        while (cnt--)
-          update_scr_pos(*p++, 1);
+        update_scr_pos_blk(p, (size_t)rc);
       }
       return rc;
     }
@@ -259,6 +259,21 @@ long DosRWSft(int sft_idx, size_t n, __XFAR(void)bp, int mode)
   return rwblock(sft_idx, bp, n, mode);
 }
 
+/* Map the data at the file position straight from the buffer  */
+/* cache, for callers that parse a file in small pieces. Only   */
+/* local files without SHARE; NULL means use DosRWSft instead.  */
+const UBYTE FAR *DosPeekSft(int sft_idx, UWORD *len)
+{
+  sft FAR *s = idx_to_sft(sft_idx);
+
+  *len = 0;
+  if (FP_OFF(s) == (UWORD) - 1 || (s->sft_mode & O_WRONLY) ||
+      (s->sft_flags & (SFT_FSHARED | SFT_FDEVICE)) ||
+      (IsShareInstalled(FALSE) && s->sft_shroff >= 0))
+    return NULL;
+  return dos_peek(sft_idx, len);
+}
+
 COUNT SftSeek(int sft_idx, LONG new_pos, unsigned mode)
 {
   sft FAR *s = idx_to_sft(sft_idx);
@@ -682,6 +697,11 @@ COUNT DosCloseSft(int sft_idx, BOOL commitonly)
     sftp->sft_shroff = -1;
   }
 /* /// End of additions for SHARE.  - Ron Cemer */
+  if (sftp->sft_count == 1)
+  {
+    extcache_del(sft_idx);
+    ra_del(sft_idx);
+  }
   sftp->sft_count -= 1;
   return SUCCESS;
 }
@@ -41,6 +41,7 @@ segment HMA_TEXT
                 extern   _user_r
                 extern   _ErrorMode
                 extern   _InDOS
+                extern   _seccache_wb_pending
                 extern   _cu_psp
                 extern   _MachineId
                 extern   critical_sp
@@ -196,6 +197,17 @@ reloc_call_int6_handler:
 
                 global reloc_call_int19_handler
 reloc_call_int19_handler:
+; fdpp: write out the sectors delayed by the host sector cache,
+; if there are any and DOS itself was not interrupted
+                mov     ax,[cs:_DGROUP_]
+                mov     ds,ax
+                cmp     byte [_seccache_wb_pending],0
+                je      int19_noflush
+                cmp     byte [_InDOS],0
+                jne     int19_noflush
+                mov     ah,0dh          ; disk reset
+                int     21h
+int19_noflush:
 ; from Japheth's public domain code (JEMFBHLP.ASM)
 ; restores int 10,13,15,19,1b and then calls the original int 19.
                 cld
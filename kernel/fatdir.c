@@ -29,6 +29,7 @@
 
 #include "portab.h"
 #include "globals.h"
+#include "dirindex.h"
 
 #ifdef VERSION_STRINGS
 static BYTE *fatdirRcsId =
@@ -109,10 +110,9 @@ f_node_ptr dir_open(REG const char *dirname, BOOL split, f_node_ptr fnp)
     /* find the entry...                    */
     i = FALSE;
 
-    while (dir_read(fnp) == 1)
+    while (dir_find_next(fnp, fcbname) == 1)
     {
-      if (!(fnp->f_dir.dir_attrib & D_VOLID) &&
-          fcbmatch(fcbname, fnp->f_dir.dir_name))
+      if (!(fnp->f_dir.dir_attrib & D_VOLID))
       {
         i = TRUE;
         break;
@@ -221,6 +221,78 @@ COUNT dir_read(REG f_node_ptr fnp)
   return (fnp->f_dir.dir_name[0] != '\0');
 }
 
+/* Description.
+ *  Reads all entries of the directory of fnp into a host-side name
+ *  index, see dirindex.cpp. fnp->f_dmp->dm_entry is preserved.
+ * Return value.
+ *  TRUE  - the index is complete.
+ *  FALSE - a read error occured, there is no index.
+ */
+STATIC BOOL build_dirindex(f_node_ptr fnp)
+{
+  unsigned entry = fnp->f_dmp->dm_entry;
+  int unit = fnp->f_dpb->dpb_unit;
+  CLUSTER dir = fnp->f_dmp->dm_dircluster;
+  COUNT rc;
+
+  dirindex_begin(unit, dir);
+  for (fnp->f_dmp->dm_entry = 0; (rc = dir_read(fnp)) == 1;
+       fnp->f_dmp->dm_entry++)
+  {
+    if (fnp->f_dir.dir_name[0] != DELETED)
+      dirindex_set(unit, dir, fnp->f_dmp->dm_entry, fnp->f_dir.dir_name);
+  }
+  fnp->f_dmp->dm_entry = entry;
+  if (rc < 0 && rc != DE_SEEK)
+  {
+    dirindex_del(unit, dir);
+    return FALSE;
+  }
+  dirindex_done(unit, dir);
+  return TRUE;
+}
+
+/* Description.
+ *  Starting at fnp->f_dmp->dm_entry, find and read the next entry
+ *  with the given FCB name; same as a dir_read() loop that compares
+ *  the names, but uses the directory name index when possible.
+ * Return value.
+ *  1              - entry found, dm_entry and the fnode point to it.
+ *  otherwise      - not found, the value dir_read() ended the scan with.
+ */
+COUNT dir_find_next(f_node_ptr fnp, const char *name)
+{
+  int unit = fnp->f_dpb->dpb_unit;
+  CLUSTER dir = fnp->f_dmp->dm_dircluster;
+  unsigned from = fnp->f_dmp->dm_entry;
+  unsigned entry;
+  COUNT rc;
+  int ix = dirindex_find(unit, dir, name, from, &entry);
+
+  if (ix < 0 && build_dirindex(fnp))
+    ix = dirindex_find(unit, dir, name, from, &entry);
+  if (ix == 0)
+    return 0;
+  if (ix > 0)
+  {
+    fnp->f_dmp->dm_entry = entry;
+    rc = dir_read(fnp);
+    if (rc == 1 && fcbmatch(name, fnp->f_dir.dir_name))
+      return 1;
+    /* the index missed a change: forget it and scan */
+    dirindex_del(unit, dir);
+    fnp->f_dmp->dm_entry = from;
+  }
+
+  while ((rc = dir_read(fnp)) == 1)
+  {
+    if (fcbmatch(name, fnp->f_dir.dir_name))
+      return 1;
+    fnp->f_dmp->dm_entry++;
+  }
+  return rc;
+}
+
 /* Description.
  *  Writes directory entry pointed by fnp to disk. In case of erroneous
  *  situation fnode is released.
@@ -256,6 +328,11 @@ BOOL dir_write_update(REG f_node_ptr fnp, BOOL update)
     if (update)
     {
       /* only update fields that are also in the SFT, for dos_close/commit */
+      /* the name changes if the file was renamed while open; this fnode */
+      /* comes from the SFT and has no index key, so drop the unit's     */
+      if (fmemcmp(&vp[DIR_NAME], fnp->f_dir.dir_name,
+                  FNAME_SIZE + FEXT_SIZE) != 0)
+        dirindex_del_unit(fnp->f_dpb->dpb_unit);
       fmemcpy(&vp[DIR_NAME], fnp->f_dir.dir_name, FNAME_SIZE + FEXT_SIZE);
       fputbyte(&vp[DIR_ATTRIB], fnp->f_dir.dir_attrib);
       fputword(&vp[DIR_TIME], fnp->f_dir.dir_time);
@@ -274,6 +351,14 @@ BOOL dir_write_update(REG f_node_ptr fnp, BOOL update)
 
     swap_deleted(fnp->f_dir.dir_name);
 
+    /* keep the name index in sync with the new entry */
+    if (!update)
+      dirindex_set(fnp->f_dpb->dpb_unit, fnp->f_dmp->dm_dircluster,
+                   fnp->f_dmp->dm_entry,
+                   (fnp->f_dir.dir_name[0] == DELETED ||
+                    fnp->f_dir.dir_name[0] == '\0') ?
+                   NULL : fnp->f_dir.dir_name);
+
     bp->b_flag &= ~(BFR_DATA | BFR_FAT);
     bp->b_flag |= BFR_DIR | BFR_DIRTY | BFR_VALID;
   }
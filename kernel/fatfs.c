@@ -29,6 +29,12 @@
 
 #include "portab.h"
 #include "globals.h"
+#include "extcache.h"
+#include "fatmap.h"
+#include "seccache.h"
+#include "readahead.h"
+#include "execache.h"
+#include "dirindex.h"
 
 #ifdef VERSION_STRINGS
 BYTE *RcsId = "$Id: fatfs.c 1632 2011-06-13 16:29:14Z bartoldeman $";
@@ -50,6 +56,7 @@ STATIC COUNT extend_dir(f_node_ptr);
 CLUSTER first_fat(f_node_ptr);
 COUNT map_cluster(f_node_ptr, COUNT);
 STATIC int shrink_file(f_node_ptr fnp);
+STATIC VOID readahead(int fd, f_node_ptr fnp, ULONG blkno, unsigned sector);
 
 /* FAT time notation in the form of hhhh hmmm mmmd dddd (d = double second) */
 STATIC _time time_encode(struct dostime *t)
@@ -290,10 +297,9 @@ STATIC int find_fname(const char *path, int attr, f_node_ptr fnp)
   if ((fnp = split_path(path, fnp)) == NULL)
     return DE_PATHNOTFND;
 
-  while (dir_read(fnp) == 1)
+  while (dir_find_next(fnp, fnp->f_dmp->dm_name_pat) == 1)
   {
-    if (fcbmatch(fnp->f_dir.dir_name, fnp->f_dmp->dm_name_pat)
-        && (fnp->f_dir.dir_attrib & ~(D_RDONLY | D_ARCHIVE | attr)) == 0)
+    if ((fnp->f_dir.dir_attrib & ~(D_RDONLY | D_ARCHIVE | attr)) == 0)
     {
       return SUCCESS;
     }
@@ -524,6 +530,7 @@ COUNT dos_rename(const char * path1, const char * path2, int attrib)
   ret = find_fname(path1, attrib, fnp1);
   if (ret != SUCCESS)
     return ret;
+  execache_inval(fnp1->f_dpb->dpb_unit, getdstart(fnp1->f_dpb, &fnp1->f_dir));
 
   /* Check that we don't have a duplicate name, so if we find     */
   /* one, it's an error.                                          */
@@ -622,7 +629,12 @@ STATIC VOID wipe_out(f_node_ptr fnp)
   /* if not already free and valid file, do it */
   CLUSTER cluster = getdstart(fnp->f_dpb, &fnp->f_dir);
   if (cluster != FREE)
+  {
+    extcache_trunc(fnp->f_dpb->dpb_unit, cluster, 0);
+    execache_inval(fnp->f_dpb->dpb_unit, cluster);
+    dirindex_del(fnp->f_dpb->dpb_unit, cluster);
     wipe_out_clusters(fnp->f_dpb, cluster);
+  }
   /* no flushing here: could get lost chain or "crosslink seed" but */
   /* it would be annoying if mass-deletes could not use BUFFERS...  */
 }
@@ -728,6 +740,21 @@ STATIC CLUSTER find_fat_free(f_node_ptr fnp)
   /* Search the FAT table looking for the first free      */
   /* entry.                                               */
   cluster = idx;
+#ifndef CHECK_FAT_DURING_CLUSTER_ALLOC
+  if (build_fatmap(dpbp))
+  {
+    idx = fatmap_find(dpbp->dpb_unit, idx);
+    if (idx)
+      cluster = idx;
+    else
+    {
+      /* No empty clusters, disk is FULL!                     */
+      cluster = UNKNCLUSTER;
+      idx = LONG_LAST_CLUSTER;
+    }
+  }
+  else
+#endif
   for (;;)
   {
 #ifdef CHECK_FAT_DURING_CLUSTER_ALLOC /* slower but nice side effect ;-) */
@@ -1007,6 +1034,21 @@ COUNT map_cluster(REG f_node_ptr fnp, COUNT mode)
     fnp->f_cluster_offset = 0;
   }
 
+  /* For files, the host remembers the chain walked so far, so    */
+  /* start from the closest cluster known to precede the target.  */
+  if (fnp->f_sft_idx != 0xff && fnp->f_cluster_offset < relcluster)
+  {
+    ULONG rel = relcluster, clus;
+
+    if (extcache_find(fnp->f_sft_idx, fnp->f_dpb->dpb_unit,
+                      getdstart(fnp->f_dpb, &fnp->f_dir), &rel, &clus) &&
+        rel > fnp->f_cluster_offset)
+    {
+      fnp->f_cluster = clus;
+      fnp->f_cluster_offset = rel;
+    }
+  }
+
   /* Now begin the linear search. The relative cluster is         */
   /* maintained as part of the set of physical indices. It is     */
   /* also the highest order index and is mapped directly into     */
@@ -1038,6 +1080,10 @@ COUNT map_cluster(REG f_node_ptr fnp, COUNT mode)
 
     fnp->f_cluster = cluster;
     fnp->f_cluster_offset++;
+    if (fnp->f_sft_idx != 0xff)
+      extcache_add(fnp->f_sft_idx, fnp->f_dpb->dpb_unit,
+                   getdstart(fnp->f_dpb, &fnp->f_dir),
+                   fnp->f_cluster_offset, cluster);
   }
 
 #ifdef DISPLAY_GETBLOCK
@@ -1205,6 +1251,7 @@ long rwblock(COUNT fd, VOID FAR * buffer, UCOUNT count, int mode)
   unsigned secsize;
   unsigned to_xfer = count;
   ULONG currentblock;
+  BOOL streaming = FALSE;
 
 #if 0 /*DSK_DEBUG*/
   if (bDumpRdWrParms)
@@ -1216,6 +1263,7 @@ long rwblock(COUNT fd, VOID FAR * buffer, UCOUNT count, int mode)
 
   if (mode==XFR_WRITE)
   {
+    execache_inval(fnp->f_dpb->dpb_unit, getdstart(fnp->f_dpb, &fnp->f_dir));
     fnp->f_dir.dir_attrib |= D_ARCHIVE;
     /* mark file as modified and set date not valid any more */
     fnp->f_flags &= ~(SFT_FCLEAN|SFT_FDATE);
@@ -1256,6 +1304,11 @@ long rwblock(COUNT fd, VOID FAR * buffer, UCOUNT count, int mode)
   /* The variable secsize will be used later.                     */
   secsize = fnp->f_dpb->dpb_secsize;
 
+  /* XferBuffer only exists after PostConfig(), while READAHEAD=  */
+  /* already sets XferBufSecs in config pass 1                    */
+  if (mode == XFR_READ && XferBuffer != NULL && seccache_enabled())
+    streaming = ra_note(fd, fnp->f_offset, count);
+
   /* Adjust the far pointer from user space to supervisor space   */
   buffer = adjust_far(buffer);
 
@@ -1385,6 +1438,9 @@ long rwblock(COUNT fd, VOID FAR * buffer, UCOUNT count, int mode)
            fnp->f_count, fnp->f_dmp->dm_entry, fnp->f_cluster, mode);
 #endif
 
+    if (streaming)
+      readahead(fd, fnp, currentblock, sector);
+
     /* Get the block we need from cache                     */
     bp = getblock(currentblock
                     /*clus2phys(fnp->f_cluster, fnp->f_dpb) + fnp->f_sector */
@@ -1452,6 +1508,71 @@ long rwblock(COUNT fd, VOID FAR * buffer, UCOUNT count, int mode)
   return ret_cnt;
 }
 
+/* Return the cached data at the file position of fd and the   */
+/* number of bytes of it up to the end of the sector or file.   */
+/* The pointer is only valid until the next buffer access.      */
+/* Does not move the file position. NULL at EOF or on error.    */
+const UBYTE FAR *dos_peek(COUNT fd, UWORD *len)
+{
+  f_node_ptr fnp = sft_to_fnode(fd);
+  struct buffer FAR *bp;
+  unsigned secsize = fnp->f_dpb->dpb_secsize;
+  unsigned sector, boff;
+
+  *len = 0;
+  if (fnp->f_offset >= fnp->f_dir.dir_size ||
+      map_cluster(fnp, XFR_READ) != SUCCESS)
+    return NULL;
+
+  sector = (UBYTE)(fnp->f_offset / secsize) & fnp->f_dpb->dpb_clsmask;
+  boff = (UWORD)(fnp->f_offset % secsize);
+  bp = getblock(clus2phys(fnp->f_cluster, fnp->f_dpb) + sector,
+                fnp->f_dpb->dpb_unit);
+  /* keep the cluster position for the next call */
+  fnode_to_sft(fnp);
+  if (bp == NULL)
+    return NULL;
+
+  *len = (UWORD)min(secsize - boff, fnp->f_dir.dir_size - fnp->f_offset);
+  return &bp->b_buffer[boff];
+}
+
+/* Prefetch the sectors following blkno into the host sector    */
+/* cache with one transfer, as far as the file stays physically */
+/* contiguous. The reads that follow are then served from there.*/
+STATIC VOID readahead(int fd, f_node_ptr fnp, ULONG blkno, unsigned sector)
+{
+  struct dpb FAR *dpbp = fnp->f_dpb;
+  unsigned secsize = dpbp->dpb_secsize;
+  ULONG start = fnp->f_offset - fnp->f_offset % secsize;
+  ULONG left = (fnp->f_dir.dir_size - start + secsize - 1) / secsize;
+  CLUSTER cluster = fnp->f_cluster;
+  unsigned want, n;
+
+  if (XferBuffer == NULL)
+    return;
+  want = ra_window(fd, fnp->f_offset, XferBufSecs);
+  if (want > left)
+    want = (unsigned)left;
+
+  n = dpbp->dpb_clsmask + 1 - sector;
+  while (n < want)
+  {
+    CLUSTER next = next_cluster(dpbp, cluster);
+    if (next != cluster + 1)
+      break;
+    cluster = next;
+    n += dpbp->dpb_clsmask + 1;
+  }
+  n = min(n, want);
+  if (n <= 1)
+    return;
+
+  /* errors are left for the real read to report */
+  if (dskxfer(dpbp->dpb_unit, blkno, XferBuffer, n, DSKREAD) == 0)
+    ra_mark(fd, start + (ULONG)n * secsize);
+}
+
 /* returns the number of unused clusters */
 CLUSTER dos_free(struct dpb FAR * dpbp)
 {
@@ -1474,6 +1595,23 @@ CLUSTER dos_free(struct dpb FAR * dpbp)
     return dpbp->dpb_nfreeclst;
 
   cnt = 0;
+#ifndef CHECK_FAT_DURING_SPACE_CHECK
+  if (build_fatmap(dpbp))
+  {
+    cnt = fatmap_count(dpbp->dpb_unit);
+    i = fatmap_find(dpbp->dpb_unit, 2);
+    if (i)
+    {
+#ifdef WITHFAT32
+      if (ISFAT32(dpbp))
+        dpbp->dpb_xcluster = i;
+      else
+#endif
+        dpbp->dpb_cluster = (UWORD)i;
+    }
+  }
+  else
+#endif
   for (i = 2; i <= max_cluster; i++)
   {
 #ifdef CHECK_FAT_DURING_SPACE_CHECK /* slower but nice side effect ;-) */
@@ -1591,6 +1729,8 @@ VOID bpb_to_dpb(bpb FAR * bpbp, REG struct dpb FAR * dpbp)
   REG UWORD shftcnt;
   bpb sbpb;
 
+  /* delayed sectors must go out with the old sector size */
+  flush_seccache(dpbp->dpb_unit);
   fmemcpy_n(&sbpb, bpbp, sizeof(sbpb));
   for (shftcnt = 0; (sbpb.bpb_nsector >> shftcnt) > 1; shftcnt++)
     ;
@@ -1630,6 +1770,8 @@ ckok:;
   }
   dpbp->dpb_flags = 0;
   dpbp->dpb_cluster = UNKNCLUSTER;
+  fatmap_del_unit(dpbp->dpb_unit);
+  dirindex_del_unit(dpbp->dpb_unit);
   /* number of free clusters */
   dpbp->dpb_nfreeclst = UNKNCLSTFREE;
 
@@ -1838,6 +1980,10 @@ STATIC int shrink_file(f_node_ptr fnp)
   /* last cluster is encountered.                         */
   /* zap the FAT pointed to                       */
 
+  /* forget the clusters after the new end in all open handles */
+  extcache_trunc(dpbp->dpb_unit, getdstart(dpbp, &fnp->f_dir),
+                 fnp->f_dir.dir_size ? fnp->f_cluster_offset + 1 : 0);
+
   if (fnp->f_dir.dir_size == 0) /* file shrinks to size 0 */
   {
     fnp->f_cluster = FREE;
@@ -28,6 +28,7 @@
 
 #include "portab.h"
 #include "globals.h"
+#include "fatmap.h"
 
 #ifdef VERSION_STRINGS
 static BYTE *RcsId =
@@ -165,6 +166,7 @@ CLUSTER link_fat(struct dpb FAR * dpbp, CLUSTER Cluster1,
   unsigned idx;
   unsigned secdiv; /* FAT entries per sector; nibbles for FAT12! */
   unsigned char wasfree;
+  UDWORD ent;
   CLUSTER clussec = Cluster1;
   CLUSTER max_cluster = dpbp->dpb_size;
 
@@ -217,6 +219,29 @@ CLUSTER link_fat(struct dpb FAR * dpbp, CLUSTER Cluster1,
   }
 #endif
 
+  /* Serve reads from the host copy of the FAT, if there is one */
+  if (Cluster2 == READ_CLUSTER &&
+      fatmap_get(dpbp->dpb_unit, Cluster1, &ent))
+  {
+    if (ISFAT12(dpbp))
+    {
+      if (ent >= MASK12)
+        return LONG_LAST_CLUSTER;
+      if (ent == BAD12)
+        return LONG_BAD;
+    }
+    else if (ISFAT16(dpbp))
+    {
+      if (ent >= MASK16)
+        return LONG_LAST_CLUSTER;
+      if (ent == BAD16)
+        return LONG_BAD;
+    }
+    else if (ent > LONG_BAD)
+      return LONG_LAST_CLUSTER;
+    return ent;
+  }
+
   /* Get the block that this cluster is in                */
   bp = getFATblock(dpbp, clussec);
 
@@ -352,6 +377,7 @@ CLUSTER link_fat(struct dpb FAR * dpbp, CLUSTER Cluster1,
 
   /* update the free space count                          */
   bp->b_flag |= BFR_DIRTY | BFR_VALID;
+  fatmap_set(dpbp->dpb_unit, Cluster1, Cluster2);
   if (Cluster2 == FREE || wasfree)
   {
     int adjust = 0;
@@ -412,3 +438,62 @@ BOOL is_free_cluster(struct dpb FAR * dpbp, CLUSTER ClusterNum)
 {
   return (link_fat(dpbp, ClusterNum, READ_CLUSTER) == FREE);
 }
+
+/* make sure the host has a copy of the FAT of this drive.         */
+/* Dirty FAT buffers are written out first, then the FAT is read   */
+/* past the buffer cache so that loading it does not evict the     */
+/* buffers. Returns FALSE on I/O error or if the FAT is too big.   */
+BOOL build_fatmap(struct dpb FAR * dpbp)
+{
+  CLUSTER max_cluster = dpbp->dpb_size;
+  ULONG clussec = dpbp->dpb_fatstrt;
+  ULONG fatsize = dpbp->dpb_fatsize;
+  ULONG nsec, sec;
+  unsigned secsize = dpbp->dpb_secsize;
+  unsigned fatbits = ISFAT12(dpbp) ? 12 : 16;
+  VOID FAR *buf = deblock_buf;
+  unsigned max = 1, n;
+
+  if (fatmap_valid(dpbp->dpb_unit))
+    return TRUE;
+
+#ifdef WITHFAT32
+  if (ISFAT32(dpbp))
+  {
+    max_cluster = dpbp->dpb_xsize;
+    fatsize = dpbp->dpb_xfatsize;
+    fatbits = 32;
+    if (dpbp->dpb_xflags & FAT_NO_MIRRORING)
+      clussec += (dpbp->dpb_xflags & 0xf) * dpbp->dpb_xfatsize;
+  }
+#endif
+
+  nsec = (fatmap_init(dpbp->dpb_unit, max_cluster, fatbits) + secsize - 1) /
+      secsize;
+  if (nsec == 0)
+    return FALSE;
+  if (nsec > fatsize)
+    nsec = fatsize;
+
+  DeleteBlockInBufferCache(clussec, clussec + nsec - 1, dpbp->dpb_unit,
+                           XFR_READ);
+  /* read in runs through the transfer buffer once it exists */
+  if (XferBuffer != NULL && XferBufSecs >= 2)
+  {
+    buf = XferBuffer;
+    max = XferBufSecs;
+  }
+  for (sec = 0; sec < nsec; sec += n)
+  {
+    n = (unsigned)min((ULONG)max, nsec - sec);
+    if (dskxfer(dpbp->dpb_unit, clussec + sec, buf, n, DSKREAD))
+    {
+      clusterMessage("I/O: 0x", clussec + sec);
+      fatmap_del_unit(dpbp->dpb_unit);
+      return FALSE;
+    }
+    fatmap_load(dpbp->dpb_unit, sec * secsize, buf, n * secsize);
+  }
+  fatmap_done(dpbp->dpb_unit);
+  return TRUE;
+}
@@ -144,3 +144,4 @@ __ASM_FUNC(got_cbreak) SEMIC
 __ASM_FUNC(cpm_entry) SEMIC
 __ASM_ARRI_F(const BYTE, os_release) SEMIC
 __ASM(UWORD, DaysSinceEpoch) SEMIC
+__ASM(UBYTE, seccache_wb_pending) SEMIC
@@ -226,6 +226,8 @@ struct __SecPathBuffer                  /* Alternate path name parsing buffer
   NumFloppies; !!*//* How many floppies we have            */
 
 extern __FAR(UBYTE) DiskTransferBuffer;
+extern __FAR(UBYTE) XferBuffer;
+extern UWORD XferBufSecs;
 extern __FAR(ddt) ddt_buf[26];
 
 /* start of uncontrolled variables                                      */
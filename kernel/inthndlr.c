@@ -31,6 +31,10 @@
 #include "portab.h"
 #include "globals.h"
 #include "nls.h"
+#include "extcache.h"
+#include "fatmap.h"
+#include "execache.h"
+#include "dirindex.h"
 
 #ifdef VERSION_STRINGS
 BYTE *RcsId =
@@ -398,6 +402,7 @@ VOID ASMCFUNC int21_service(iregs FAR * r)
   fmemcpy_n(&lr, r, sizeof(lregs) - 4);
   lr.DS = r->DS;
   lr.ES = r->ES;
+  fdprof_int21_enter(lr.AH);
 
 dispatch:
 
@@ -1657,6 +1662,7 @@ exit_dispatch:
 real_exit:;
 
   psp->ps_stack = user_stack;
+  fdprof_int21_leave();
 
 #ifdef DEBUG
   if (bDumpRegs)
@@ -1747,6 +1753,14 @@ VOID ASMCFUNC int2526_handler(WORD mode, struct int25regs FAR * r)
 
   InDOS++;
 
+  /* raw writes may touch the FAT and directories behind our back */
+  if (mode == DSKWRITEINT26)
+  {
+    extcache_del_unit(drv);
+    fatmap_del_unit(drv);
+    execache_inval_unit(drv);
+    dirindex_del_unit(drv);
+  }
   r->ax = dskxfer(drv, blkno, buf, nblks, mode);
 
   CLEAR_CARRY_FLAG();
@@ -206,6 +206,16 @@ COUNT DosDevIOctl(lregs * r)
           return SUCCESS;
         }
         case 0x0d:
+          /* set params, write track, format, set media ID and the  */
+          /* volume locks may change sectors behind the host caches */
+          if ((r->CH & ~0x40) == 0x08)
+            switch (r->CL)
+            {
+              case 0x40: case 0x41: case 0x42: case 0x46:
+              case 0x4a: case 0x4b: case 0x6a: case 0x6b:
+                inval_host_caches(dpbp->dpb_unit);
+                break;
+            }
           if ((r->CX & ~(0x486B-0x084A)) == 0x084A)
           {             /* 084A/484A, 084B/484B, 086A/486A, 086B/486B */
             r->AX = 0;  /* (lock/unlock logical/physical volume) */
@@ -826,6 +826,10 @@ blk_stk_top:
                 times 128 dw 0
 clk_stk_top:
 
+; fdpp: set while the host sector cache may hold delayed writes
+                global  _seccache_wb_pending
+_seccache_wb_pending db 0
+
 ; Dynamic data:
 ; member of the DOS DATA GROUP
 ; and marks definitive end of all used data in kernel data segment
@@ -32,6 +32,12 @@
 #include "init-mod.h"
 #include "dyndata.h"
 #include "dosobj.h"
+#include "seccache.h"
+#include "extcache.h"
+#include "fatmap.h"
+#include "readahead.h"
+#include "execache.h"
+#include "dirindex.h"
 #include "debug.h"
 
 #ifdef VERSION_STRINGS
@@ -95,7 +101,13 @@ VOID ASMCFUNC FreeDOSmain(void)
 #ifdef FDPP
   objhlp_reset();
   run_ctors();
-#define DOSOBJ_POOL 512
+  seccache_reset();
+  extcache_reset();
+  fatmap_reset();
+  ra_reset();
+  execache_setup(0);
+  dirindex_reset();
+#define DOSOBJ_POOL DOSOBJ_POOL_SIZE(512)
   far_t fa = DynAlloc("dosobj", 1, DOSOBJ_POOL);
   dosobj_init(fa, DOSOBJ_POOL);
 #endif
@@ -38,6 +38,7 @@ __FAR(struct buffer)getblk(ULONG blkno, COUNT dsk, BOOL overwrite);
 #define getblock(blkno, dsk) getblk(blkno, dsk, FALSE);
 #define getblockOver(blkno, dsk) getblk(blkno, dsk, TRUE);
 VOID setinvld(REG COUNT dsk);
+VOID inval_host_caches(REG COUNT dsk);
 BOOL dirty_buffers(REG COUNT dsk);
 BOOL flush_buffers(REG COUNT dsk);
 BOOL flush(void);
@@ -47,6 +48,7 @@ BOOL DeleteBlockInBufferCache(ULONG blknolow, ULONG blknohigh, COUNT dsk, int mo
 UWORD dskxfer(COUNT dsk, ULONG blkno,__FAR(VOID) buf, UWORD numblocks,
               COUNT mode);
 /* *** End of change */
+BOOL flush_seccache(COUNT dsk);
 void AllocateHMASpace (size_t lowbuffer, size_t highbuffer);
 
 /* break.c */
@@ -72,6 +74,7 @@ size_t read_line_handle(int sft_idx, size_t n,__FAR(char) bp);
 void write_char(int c, int sft_idx);
 void write_char_stdout(int c);
 void update_scr_pos(unsigned char c, unsigned char count);
+void update_scr_pos_blk(__FAR(const char) bp, size_t n);
 long cooked_write(__DOSFAR(struct dhdr)*pdev, size_t n,__XFAR(const char)bp);
 
 __FAR(sft)get_sft(UCOUNT);
@@ -86,6 +89,7 @@ COUNT SftSeek(int sft_idx, LONG new_pos, unsigned mode);
 void BinarySftIO(int sft_idx, void *bp, int mode);
 #define BinaryIO(hndl, bp, mode) BinarySftIO(get_sft_idx(hndl), bp, mode)
 long DosRWSft(int sft_idx, size_t n, __XFAR(void) bp, int mode);
+__FAR(const UBYTE) DosPeekSft(int sft_idx, UWORD *len);
 #define DosRead(hndl, n, bp) DosRWSft(get_sft_idx(hndl), n, bp, XFR_READ)
 #define DosWrite(hndl, n, bp) DosRWSft(get_sft_idx(hndl), n, bp, XFR_WRITE)
 ULONG DosSeek(unsigned hndl, LONG new_pos, COUNT mode, COUNT *rc);
@@ -140,6 +144,7 @@ VOID fatal(const char * err_msg);
 VOID dir_init_fnode(f_node_ptr fnp, CLUSTER dirstart);
 f_node_ptr dir_open(const char *dirname, BOOL split, f_node_ptr fnp);
 COUNT dir_read(REG f_node_ptr fnp);
+COUNT dir_find_next(f_node_ptr fnp, const char *name);
 BOOL dir_write_update(REG f_node_ptr fnp, BOOL update);
 #define dir_write(fnp) dir_write_update(fnp, FALSE)
 COUNT dos_findfirst(UCOUNT attr, const char * name);
@@ -165,6 +170,7 @@ COUNT dos_mkdir(const char * dir);
 BOOL last_link(f_node_ptr fnp);
 COUNT map_cluster(REG f_node_ptr fnp, COUNT mode);
 long rwblock(COUNT fd,__FAR(VOID) buffer, UCOUNT count, int mode);
+__FAR(const UBYTE) dos_peek(COUNT fd, UWORD *len);
 COUNT dos_read(COUNT fd,__FAR(VOID) buffer, UCOUNT count);
 COUNT dos_write(COUNT fd,__FAR(const VOID) buffer, UCOUNT count);
 CLUSTER dos_free(__FAR(struct dpb) dpbp);
@@ -190,6 +196,7 @@ CLUSTER link_fat(__FAR(struct dpb) dpbp, CLUSTER Cluster1,
                  REG CLUSTER Cluster2);
 CLUSTER next_cluster(__FAR(struct dpb) dpbp, REG CLUSTER ClusterNum);
 BOOL is_free_cluster(__FAR(struct dpb) dpbp, REG CLUSTER ClusterNum);
+BOOL build_fatmap(__FAR(struct dpb) dpbp);
 
 /* fcbfns.c */
 VOID DosOutputString(__FAR(const char) s);
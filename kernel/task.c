@@ -29,6 +29,7 @@
 #include "portab.h"
 #include "globals.h"
 #include "init-mod.h"
+#include "execache.h"
 
 #ifdef VERSION_STRINGS
 static BYTE *RcsId =
@@ -419,6 +420,23 @@ STATIC int ExecMemAlloc(UWORD size, seg *para, UWORD *asize)
   return rc;
 }
 
+/* look up the file of fd in the executable cache, or start a new */
+/* entry for it; -1 if it can not be cached                       */
+STATIC int exe_cache(COUNT fd, BOOL create)
+{
+  sft FAR *s = idx_to_sft(fd);
+  int unit;
+
+  if (!execache_enabled() || (s->sft_flags & (SFT_FSHARED | SFT_FDEVICE)))
+    return -1;
+  unit = s->sft_dcb->dpb_unit;
+  if (create)
+    return execache_new(unit, s->sft_stclust, s->sft_size, s->sft_date,
+                        s->sft_time);
+  return execache_find(unit, s->sft_stclust, s->sft_size, s->sft_date,
+                       s->sft_time);
+}
+
 STATIC COUNT DosComLoader(const char FAR * namep, exec_blk FAR * exp, COUNT mode, COUNT fd)
 {
   UWORD mem;
@@ -478,6 +496,9 @@ STATIC COUNT DosComLoader(const char FAR * namep, exec_blk FAR * exp, COUNT mode
   /* Now load the executable                              */
   {
     BYTE FAR *sp;
+    UWORD limit = (mode == OVERLAY) ? 0xfffeU : 0xff00U;
+    ULONG len;
+    int cid;
 
     if (mode == OVERLAY)  /* memory already allocated */
       sp = MK_FP(mem, 0);
@@ -487,11 +508,28 @@ STATIC COUNT DosComLoader(const char FAR * namep, exec_blk FAR * exp, COUNT mode
     /* MS DOS always only loads the very first 64KB - sizeof(psp) bytes.
        -- 1999/04/21 ska */
 
-    /* rewind to start */
-    SftSeek(fd, 0, 0);
-    /* read everything, but at most 64K - sizeof(PSP)             */
-    /* lpproj: some device drivers (not exe) are larger than 0xff00bytes... */
-    DosRWSft(fd, (mode == OVERLAY) ? 0xfffeU : 0xff00U, sp, XFR_READ);
+    /* the cached copy will do if it holds all we would read      */
+    cid = exe_cache(fd, FALSE);
+    len = (cid == -1) ? 0 : execache_image_len(cid);
+    if (cid != -1 && (len >= limit || len == idx_to_sft(fd)->sft_size))
+      execache_get(cid, 0, sp, (UWORD)min(len, limit));
+    else
+    {
+      long nBytesRead;
+
+      /* rewind to start */
+      SftSeek(fd, 0, 0);
+      /* read everything, but at most 64K - sizeof(PSP)             */
+      /* lpproj: some device drivers (not exe) are larger than 0xff00bytes... */
+      nBytesRead = DosRWSft(fd, limit, sp, XFR_READ);
+      cid = exe_cache(fd, TRUE);
+      if (cid != -1)
+      {
+        if (nBytesRead > 0)
+          execache_put(cid, sp, (unsigned)nBytesRead);
+        execache_done(cid);
+      }
+    }
     DosCloseSft(fd, FALSE);
   }
 
@@ -576,6 +614,8 @@ STATIC COUNT DosExeLoader(const char FAR * namep, exec_blk FAR * exp, COUNT mode
 {
   UWORD mem, env, start_seg, asize = 0;
   UWORD exe_size;
+  int cid;
+  BOOL cached;
   {
     UWORD image_size;
 
@@ -701,16 +741,37 @@ STATIC COUNT DosExeLoader(const char FAR * namep, exec_blk FAR * exp, COUNT mode
     }
   }
 
-  /* read in the image in 32256 chunks                      */
+  cid = exe_cache(fd, FALSE);
+  cached = (cid != -1);
+  if (cached)
   {
+    /* copy the image as it was read last time                */
+    ULONG len = execache_image_len(cid), off = 0;
+    seg sp = start_seg;
+
+    while (len)
+    {
+      UWORD n = (UWORD)min(len, CHUNK);
+      execache_get(cid, off, MK_FP(sp, 0), n);
+      sp += CHUNK/16;
+      off += n;
+      len -= n;
+    }
+  }
+  else
+  {
+    /* read in the image in 32256 chunks                      */
     int nBytesRead, toRead = CHUNK;
     seg sp = start_seg;
 
+    cid = exe_cache(fd, TRUE);
     while (1)
     {
       if (exe_size < CHUNK/16)
         toRead = exe_size*16;
       nBytesRead = (WORD)DosRWSft(fd, toRead, MK_FP(sp, 0), XFR_READ);
+      if (cid != -1 && nBytesRead > 0)
+        execache_put(cid, MK_FP(sp, 0), nBytesRead);
       if (nBytesRead < toRead || exe_size <= CHUNK/16)
         break;
       sp += CHUNK/16;
@@ -719,34 +780,69 @@ STATIC COUNT DosExeLoader(const char FAR * namep, exec_blk FAR * exp, COUNT mode
   }
 
   {                             /* relocate the image for new segment                   */
-    COUNT i;
+    UWORD i, n;
     UWORD reloc[2];
     seg FAR *spot;
+    ULONG pos = ExeHeader.exRelocTable;
+    /*      spot = MK_FP(reloc[1] + mem + 0x10, reloc[0]); */
+    seg base = (mode == OVERLAY ? mem : start_seg);
+    seg delta = (mode == OVERLAY ? exp->load.reloc : start_seg);
 
-    SftSeek(fd, ExeHeader.exRelocTable, 0);
-    for (i = 0; i < ExeHeader.exRelocItems; i++)
+    if (cached)
     {
-      if (DosRWSft(fd, sizeof(reloc), MK_FAR_SCP(reloc), XFR_READ) != sizeof(reloc))
+      ULONG k, nrel = execache_nrelocs(cid);
+      for (k = 0; k < nrel; k++)
       {
-        if (mode != OVERLAY)
-        {
-          DosMemFree(--mem);
-          DosMemFree(env);
-        }
-        return DE_INVLDDATA;
+        ULONG r = execache_reloc(cid, k);
+        spot = MK_FP((UWORD)(r >> 16) + base, (UWORD)r);
+        *spot += delta;
       }
-      if (mode == OVERLAY)
+    }
+    /* take the entries straight from the cached sectors of the  */
+    /* file, one sector at a time                                */
+    else for (i = 0; i < ExeHeader.exRelocItems; i += n)
+    {
+      const UBYTE FAR *p;
+      UWORD len;
+
+      SftSeek(fd, pos, 0);
+      p = DosPeekSft(fd, &len);
+      n = min(len / sizeof(reloc), ExeHeader.exRelocItems - i);
+      if (n == 0)
       {
-        spot = MK_FP(reloc[1] + mem, reloc[0]);
-        *spot += exp->load.reloc;
+        /* remote file, or the entry crosses a sector: read it */
+        if (DosRWSft(fd, sizeof(reloc), MK_FAR_SCP(reloc), XFR_READ) != sizeof(reloc))
+        {
+          if (cid != -1)
+            execache_drop(cid);
+          if (mode != OVERLAY)
+          {
+            DosMemFree(--mem);
+            DosMemFree(env);
+          }
+          return DE_INVLDDATA;
+        }
+        if (cid != -1)
+          execache_add_reloc(cid, reloc[1], reloc[0]);
+        spot = MK_FP(reloc[1] + base, reloc[0]);
+        *spot += delta;
+        n = 1;
       }
       else
       {
-        /*      spot = MK_FP(reloc[1] + mem + 0x10, reloc[0]); */
-        spot = MK_FP(reloc[1] + start_seg, reloc[0]);
-        *spot += start_seg;
+        UWORD k;
+        for (k = 0; k < n; k++, p += sizeof(reloc))
+        {
+          if (cid != -1)
+            execache_add_reloc(cid, fgetword(p + 2), fgetword(p));
+          spot = MK_FP(fgetword(p + 2) + base, fgetword(p));
+          *spot += delta;
+        }
       }
+      pos += n * sizeof(reloc);
     }
+    if (!cached && cid != -1)
+      execache_done(cid);
   }
 
   /* and finally close the file                           */